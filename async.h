@@ -0,0 +1,229 @@
+/*!
+ * \file async.h
+ * \author PolyArch Research Lab
+ * \brief Coroutines over the streams, scheduled on a single control hart. A coroutine
+ *        launches its streams, and co_awaits them instead of blocking on SS_WAIT; the
+ *        scheduler then runs the other coroutines, and resumes it once SS_POLL finds its
+ *        streams done. Several independent pipelines, each on its own lanes or ports, can
+ *        share one control core this way. It requires C++20.
+ * \code{c}
+ *   DSACoro Pipeline(DSAScheduler *s, int lane) {
+ *     for (...) {
+ *       co_await DSA_LAUNCH(s, 1ull << lane, [&]() { SS_1D_READ(...); SS_1D_WRITE(...); });
+ *       ... // The host work on the results.
+ *     }
+ *   }
+ *   DSA_ASYNC_SPAWN(&s, Pipeline(&s, 0));
+ *   DSA_ASYNC_SPAWN(&s, Pipeline(&s, 1));
+ *   DSA_ASYNC_RUN(&s);
+ * \endcode
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#if __cplusplus < 202002L
+#error "async.h requires C++20"
+#endif
+
+#include <cassert>
+#include <coroutine>
+#include <utility>
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The max number of coroutines ready or waiting in a scheduler, which is asserted.
+ */
+#ifndef DSA_ASYNC_MAX
+#define DSA_ASYNC_MAX 64
+#endif
+
+/*!
+ * \brief A coroutine waiting for the streams of its lanes.
+ */
+struct DSAAsyncWaiter {
+  std::coroutine_handle<> handle;
+  /*!
+   * \brief The lanes of the streams, as SS_CONTEXT, and the barrier mask polled, as SS_WAIT.
+   */
+  uint64_t lanes;
+  uint64_t mask;
+};
+
+struct DSAScheduler {
+  /*!
+   * \brief The ready coroutines, a ring of DSA_ASYNC_MAX.
+   */
+  std::coroutine_handle<> ready[DSA_ASYNC_MAX];
+  int head{0}, n_ready{0};
+  DSAAsyncWaiter waiting[DSA_ASYNC_MAX];
+  int n_waiting{0};
+  /*!
+   * \brief The coroutines spawned and not finished yet.
+   */
+  int live{0};
+};
+
+/*! \brief Make the coroutine ready. */
+inline void _ASYNC_READY(DSAScheduler *s, std::coroutine_handle<> h) {
+  assert(s->n_ready < DSA_ASYNC_MAX);
+  s->ready[(s->head + s->n_ready++) % DSA_ASYNC_MAX] = h;
+}
+
+/*!
+ * \brief A coroutine of the streams. It starts when it is spawned by DSA_ASYNC_SPAWN, or
+ *        co_awaited by another coroutine, which is resumed when it finishes.
+ */
+struct DSACoro {
+  struct promise_type {
+    std::coroutine_handle<> continuation;
+    DSAScheduler *sched{nullptr};
+
+    DSACoro get_return_object() {
+      return DSACoro(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    /*!
+     * \brief Transfer to the coroutine awaiting this one, or if it is spawned, destroy
+     *        itself and return to the scheduler.
+     */
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+        promise_type &p = h.promise();
+        if (p.continuation) {
+          return p.continuation;
+        }
+        --p.sched->live;
+        h.destroy();
+        return std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { __builtin_trap(); }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+
+  explicit DSACoro(std::coroutine_handle<promise_type> h) : handle(h) {}
+  DSACoro(DSACoro &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+  DSACoro(const DSACoro &) = delete;
+  ~DSACoro() {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+    handle.promise().continuation = caller;
+    return handle;
+  }
+  void await_resume() const noexcept {}
+};
+
+/*!
+ * \brief The awaitable of the streams launched on the lanes. The coroutine is resumed on the
+ *        same lanes, i.e. SS_CONTEXT is restored, since the others may change it meanwhile.
+ */
+struct DSAStreamAwaiter {
+  DSAScheduler *sched;
+  uint64_t lanes, mask;
+
+  bool await_ready() const {
+    SS_CONTEXT(lanes);
+    return SS_POLL(mask).value != 0;
+  }
+  void await_suspend(std::coroutine_handle<> h) {
+    assert(sched->n_waiting < DSA_ASYNC_MAX);
+    sched->waiting[sched->n_waiting++] = {h, lanes, mask};
+  }
+  void await_resume() const {
+    SS_CONTEXT(lanes);
+  }
+};
+
+/*!
+ * \brief Await the streams on the lanes matching the barrier mask, all of them by default.
+ */
+inline DSAStreamAwaiter DSA_STREAMS(DSAScheduler *s, uint64_t lanes, uint64_t mask = ~0ull) {
+  return {s, lanes, mask};
+}
+
+/*!
+ * \brief Launch the streams on the lanes, and return the awaitable of them.
+ * \param launch The streams, which should not block on the accelerator.
+ */
+template<typename F>
+inline DSAStreamAwaiter DSA_LAUNCH(DSAScheduler *s, uint64_t lanes, F launch,
+                                   uint64_t mask = ~0ull) {
+  SS_CONTEXT(lanes);
+  launch();
+  return DSA_STREAMS(s, lanes, mask);
+}
+
+/*!
+ * \brief An awaitable yielding the control host to the other ready coroutines.
+ */
+struct DSAYieldAwaiter {
+  DSAScheduler *sched;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) { _ASYNC_READY(sched, h); }
+  void await_resume() const noexcept {}
+};
+
+inline DSAYieldAwaiter DSA_YIELD(DSAScheduler *s) {
+  return {s};
+}
+
+/*!
+ * \brief Hand the coroutine over to the scheduler, which starts it in DSA_ASYNC_RUN.
+ */
+inline void DSA_ASYNC_SPAWN(DSAScheduler *s, DSACoro &&coro) {
+  auto h = std::exchange(coro.handle, nullptr);
+  h.promise().sched = s;
+  ++s->live;
+  _ASYNC_READY(s, h);
+}
+
+/*!
+ * \brief Poll the waiting coroutines in the order they wait, and make the ones whose
+ *        streams are done ready.
+ * \return The number of coroutines made ready.
+ */
+inline int _ASYNC_POLL(DSAScheduler *s) {
+  int res = 0, n = 0;
+  for (int i = 0; i < s->n_waiting; ++i) {
+    DSAAsyncWaiter &w = s->waiting[i];
+    SS_CONTEXT(w.lanes);
+    if (SS_POLL(w.mask)) {
+      _ASYNC_READY(s, w.handle);
+      ++res;
+    } else {
+      s->waiting[n++] = w;
+    }
+  }
+  s->n_waiting = n;
+  return res;
+}
+
+/*!
+ * \brief Run the coroutines until all of them finish. The ready ones run in turn, and the
+ *        waiting ones are polled after each, so a coroutine is resumed soon after its
+ *        streams are done, and launches the next ones to keep the accelerator busy.
+ */
+inline void DSA_ASYNC_RUN(DSAScheduler *s) {
+  while (s->live) {
+    if (s->n_ready) {
+      std::coroutine_handle<> h = s->ready[s->head];
+      s->head = (s->head + 1) % DSA_ASYNC_MAX;
+      --s->n_ready;
+      h.resume();
+    }
+    _ASYNC_POLL(s);
+  }
+}
@@ -0,0 +1,285 @@
+/*!
+ * \file bench.cc
+ * \author PolyArch Research Lab
+ * \brief The benchmarks of the control overhead and the bandwidth of the intrinsics.
+ *        Each benchmark launches a wrapper back to back, and then waits for all of them.
+ *        A record of JSON is appended per benchmark to the output, with:
+ *        insts_per_launch: on the target, the instructions retired by the host;
+ *                          on the software model, the instructions issued to the accelerator.
+ *        cycles_per_launch: by rdcycle on the target, or estimated by the software model.
+ *        launches_per_sec: at DSA_BENCH_FREQ_MHZ.
+ *        bytes_per_cycle: the bytes of the payload of a launch per cycle.
+ *        Usage: bench [results.jsonl]
+ * \note On the target, the spatial configuration DSA_BENCH_CONFIG should pass the in port 0 to
+ *       the out port 0. The data read to the in port is then drained from the out port, and the
+ *       data written from the out port is fed to the in port, both counted in the records.
+ *       The kernels need their own configurations, so they only run on the software model.
+ * \copyright Copyright (c) 2020
+ */
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "conv.h"
+#include "gemm.h"
+
+/*!
+ * \brief The clock of the accelerator, to convert the cycles to the launches per second.
+ */
+#ifndef DSA_BENCH_FREQ_MHZ
+#define DSA_BENCH_FREQ_MHZ 1000
+#endif
+
+/*!
+ * \brief The launches of each benchmark.
+ */
+#ifndef DSA_BENCH_LAUNCHES
+#define DSA_BENCH_LAUNCHES 64
+#endif
+
+/*!
+ * \brief The tag of the records, e.g. the commit benchmarked.
+ */
+#ifndef DSA_BENCH_TAG
+#define DSA_BENCH_TAG "untagged"
+#endif
+
+#ifdef DSA_SOFT_MODEL
+#define DSA_BENCH_MODE "model"
+#else
+#define DSA_BENCH_MODE "target"
+#endif
+
+/*!
+ * \brief The pass-through ports of DSA_BENCH_CONFIG.
+ */
+#define BENCH_IN 0
+#define BENCH_OUT 0
+
+/*! \brief Drain the n elements read to the in port. */
+inline void _BENCH_DRAIN(uint64_t n, int dtype) {
+#ifndef DSA_SOFT_MODEL
+  SS_GARBAGE_GENERAL(BENCH_OUT, n, dtype);
+#else
+  (void) n;
+  (void) dtype;
+#endif
+}
+
+/*! \brief Feed the n elements written from the out port. */
+inline void _BENCH_FEED(uint64_t n, int dtype) {
+#ifndef DSA_SOFT_MODEL
+  SS_CONST(BENCH_IN, (uint64_t) 0, n, dtype);
+#else
+  (void) n;
+  (void) dtype;
+#endif
+}
+
+/*! \brief The counters of the host. */
+struct BenchCounter {
+  uint64_t cycles, insts;
+};
+
+inline BenchCounter _BENCH_READ() {
+  BenchCounter res{0, 0};
+#ifndef DSA_SOFT_MODEL
+  __asm__ __volatile__("rdcycle %0" : "=r"(res.cycles));
+  __asm__ __volatile__("rdinstret %0" : "=r"(res.insts));
+#endif
+  return res;
+}
+
+/*!
+ * \brief Run a benchmark, and append its record to the output.
+ * \param bytes The bytes of the payload of a launch.
+ * \param launch The launch of the wrapper.
+ */
+template<typename F>
+void Bench(FILE *out, const char *name, uint64_t bytes, F launch) {
+  // Warm up the caches of the host.
+  launch();
+  SS_WAIT_ALL();
+  double cycles, insts;
+#ifdef DSA_SOFT_MODEL
+  DSA_MODEL_RESET();
+  for (int i = 0; i < DSA_BENCH_LAUNCHES; ++i) {
+    launch();
+  }
+  SS_WAIT_ALL();
+  DSAModelStats stats = DSA_MODEL_STATS();
+  cycles = stats.cycles;
+  // The barrier is not a part of the launches.
+  insts = stats.insts - 1;
+#else
+  BenchCounter begin = _BENCH_READ();
+  for (int i = 0; i < DSA_BENCH_LAUNCHES; ++i) {
+    launch();
+  }
+  SS_WAIT_ALL();
+  BenchCounter end = _BENCH_READ();
+  cycles = end.cycles - begin.cycles;
+  insts = end.insts - begin.insts;
+#endif
+  cycles /= DSA_BENCH_LAUNCHES;
+  insts /= DSA_BENCH_LAUNCHES;
+  fprintf(out, "{\"tag\": \"%s\", \"mode\": \"%s\", \"name\": \"%s\", \"bytes\": %" PRIu64 ", "
+          "\"launches\": %d, \"insts_per_launch\": %.2f, \"cycles_per_launch\": %.2f, "
+          "\"launches_per_sec\": %.0f, \"bytes_per_cycle\": %.3f}\n",
+          DSA_BENCH_TAG, DSA_BENCH_MODE, name, bytes, DSA_BENCH_LAUNCHES, insts, cycles,
+          cycles > 0 ? DSA_BENCH_FREQ_MHZ * 1e6 / cycles : 0.0,
+          cycles > 0 ? bytes / cycles : 0.0);
+}
+
+/*!
+ * \brief The sizes of the payload of the wrappers, a small one dominated by the control
+ *        overhead, and a large one dominated by the bandwidth.
+ */
+const uint64_t BENCH_BYTES[] = {64, 16384};
+
+/*! \brief The wrappers of the linear streams. */
+void BenchLinear(FILE *out, REG mem, REG spad) {
+  for (uint64_t bytes : BENCH_BYTES) {
+    uint64_t n = bytes / 8;
+    Bench(out, "SS_1D_READ", bytes, [&]() {
+      SS_1D_READ(mem, bytes, BENCH_IN, DP_NoPadding, DMT_DMA, 8);
+      _BENCH_DRAIN(n, 8);
+    });
+    Bench(out, "SS_1D_READ.spad", bytes, [&]() {
+      SS_1D_READ(spad, bytes, BENCH_IN, DP_NoPadding, DMT_SPAD, 8);
+      _BENCH_DRAIN(n, 8);
+    });
+    Bench(out, "SS_1D_WRITE", bytes, [&]() {
+      _BENCH_FEED(n, 8);
+      SS_1D_WRITE(BENCH_OUT, mem, bytes, DMT_DMA, 8);
+    });
+    // Rows of 64 bytes, a line apart.
+    Bench(out, "SS_2D_READ", bytes, [&]() {
+      SS_2D_READ(mem, (uint64_t) 128, (uint64_t) 64, (uint64_t) 0, bytes / 64, BENCH_IN,
+                 DP_NoPadding, DMT_DMA);
+      _BENCH_DRAIN(bytes, 1);
+    });
+    Bench(out, "SS_DMA_2D_WRITE", bytes, [&]() {
+      _BENCH_FEED(n, 8);
+      SS_DMA_2D_WRITE(mem, (uint64_t) 16, (uint64_t) 8, (uint64_t) 0, n / 8, BENCH_OUT, 8);
+    });
+    Bench(out, "SS_CONST", bytes, [&]() {
+      SS_CONST(BENCH_IN, (uint64_t) 1, n, 8);
+      _BENCH_DRAIN(n, 8);
+    });
+    Bench(out, "SS_2D_CONST", bytes, [&]() {
+      SS_2D_CONST(BENCH_IN, (uint64_t) 1, (uint64_t) 7, (uint64_t) 0, (uint64_t) 1, n / 8, 8);
+      _BENCH_DRAIN(n, 8);
+    });
+    Bench(out, "SS_RECURRENCE", bytes, [&]() {
+      _BENCH_FEED(n, 8);
+      SS_RECURRENCE(BENCH_OUT, BENCH_IN, n, 8);
+      _BENCH_DRAIN(n, 8);
+    });
+  }
+}
+
+/*!
+ * \brief The wrappers of the indirect streams, over the indices 0, 8, 16, ... so that each
+ *        element is a line apart.
+ */
+void BenchIndirect(FILE *out, REG mem, REG spad, REG idx) {
+  for (uint64_t bytes : BENCH_BYTES) {
+    uint64_t n = bytes / 8;
+    Bench(out, "SS_INDIRECT_READ", bytes, [&]() {
+      SS_1D_READ(idx, n * 4, P_IND_1, DP_NoPadding, DMT_DMA, 4);
+      SS_INDIRECT_READ(BENCH_IN, 8, P_IND_1, 4, mem, 1, n, DMT_DMA, false, false);
+      _BENCH_DRAIN(n, 8);
+    });
+    Bench(out, "SS_INDIRECT_2D_READ", bytes, [&]() {
+      SS_1D_READ(idx, n / 8 * 4, P_IND_1, DP_NoPadding, DMT_DMA, 4);
+      Indirect2DAttr i2a;
+      i2a.dest_port = BENCH_IN;
+      i2a.dtype = 8;
+      i2a.start = mem;
+      i2a.start_port = P_IND_1;
+      i2a.start_dtype = 4;
+      i2a.l1d = (uint64_t) 8;
+      i2a.l2d = n / 8;
+      i2a.memory = DMT_DMA;
+      SS_INDIRECT_2D_READ(&i2a);
+      _BENCH_DRAIN(n, 8);
+    });
+    Bench(out, "SS_INDIRECT_ATOMIC", bytes, [&]() {
+      SS_1D_READ(idx, n * 4, P_IND_1, DP_NoPadding, DMT_DMA, 4);
+      _BENCH_FEED(n, 8);
+      SS_INDIRECT_ATOMIC(BENCH_OUT, 8, P_IND_1, 4, spad, 1, n, DMT_SPAD, DMO_Add);
+    });
+  }
+}
+
+/*! \brief The barriers and the polls on an idle accelerator. */
+void BenchBarrier(FILE *out) {
+  Bench(out, "SS_WAIT_ALL", 0, []() { SS_WAIT_ALL(); });
+  Bench(out, "SS_POLL", 0, []() {
+    REG all_ones(~0ull);
+    SS_POLL(all_ones);
+  });
+  Bench(out, "SS_REPEAT_PORT", 0, []() { SS_REPEAT_PORT(BENCH_IN, 4); });
+}
+
+/*! \brief The kernels end to end, of their payload from and to the memory. */
+void BenchKernels(FILE *out, REG a, REG b, REG c) {
+#ifdef DSA_SOFT_MODEL
+  static constexpr GemmPorts gp{0, 1, 2, 0, 3, 1};
+  GemmAttr ga;
+  ga.a = a;
+  ga.b = b;
+  ga.c = c;
+  ga.m = ga.n = ga.k = 64;
+  ga.lda = ga.ldb = ga.ldc = 64;
+  ga.dtype = 8;
+  Bench(out, "SS_GEMM.64", 4 * 64 * 64 * 8, [&]() { SS_GEMM(&ga, &gp); });
+
+  static constexpr ConvPorts cp{0, 1, 2, 0};
+  ConvAttr ca;
+  ca.in = a;
+  ca.h = ca.w = ca.pitch = 64;
+  ca.weight = b;
+  ca.k = 3;
+  ca.pad = 1;
+  ca.out = c;
+  ca.out_pitch = 64;
+  Bench(out, "SS_CONV2D.64x3", 2 * 64 * 64 * 4, [&]() { SS_CONV2D(&ca, &cp); });
+
+  static constexpr StencilPorts sp{0, 1, 2, 3, 0};
+  StencilAttr sa;
+  sa.in = a;
+  sa.out = c;
+  sa.h = sa.w = 64;
+  sa.c0 = sa.c1 = 0;
+  Bench(out, "SS_STENCIL5.64", 2 * 64 * 64 * 8, [&]() { SS_STENCIL5(&sa, &sp); });
+#endif
+}
+
+int main(int argc, char **argv) {
+  FILE *out = argc > 1 ? fopen(argv[1], "a") : stdout;
+  if (!out) {
+    perror(argv[1]);
+    return 1;
+  }
+  std::vector<uint64_t> a(64 * 1024), b(a.size()), c(a.size());
+  std::vector<uint32_t> idx(a.size() / 8);
+  for (size_t i = 0; i < idx.size(); ++i) {
+    idx[i] = i * 8;
+  }
+#if !defined(DSA_SOFT_MODEL) && defined(DSA_BENCH_CONFIG)
+  SS_CONFIG(DSA_BENCH_CONFIG, DSA_BENCH_CONFIG_SIZE);
+#endif
+  REG spad((uint64_t) 0);
+  BenchLinear(out, a.data(), spad);
+  BenchIndirect(out, a.data(), spad, idx.data());
+  BenchBarrier(out);
+  BenchKernels(out, a.data(), b.data(), c.data());
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,342 @@
+/*!
+ * \file collective.h
+ * \author PolyArch Research Lab
+ * \brief Collective primitives (allreduce, reduce-scatter, allgather, and broadcast) over
+ *        the lane ring exposed by SS_XFER.
+ *        The ports of the attributes should be compile-time constants, as SS_CONST configures
+ *        them by an immediate, while the message and the lanes may be runtime values.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The per-lane chunk size in bytes, below which the recursive-doubling variant
+ *        is preferred. Below this size, the ring variant is dominated by the per-step
+ *        launch overhead rather than the data transferred.
+ */
+#ifndef DSA_COLL_RD_THRESHOLD
+#define DSA_COLL_RD_THRESHOLD (PORT_WIDTH * 4)
+#endif
+
+enum CollectiveAlgo {
+  DCA_Auto,               // Select by the message size and the number of lanes
+  DCA_Ring,               // L-1 neighbor steps, each moves 1/L of the message
+  DCA_RecursiveDoubling,  // log2(L) rounds, each shifts the whole message by 2^k lanes
+};
+
+/*!
+ * \brief The attributes of a collective over the lane ring.
+ *        The spatial configuration on each lane is expected to compute
+ * \code{c}
+ *   out_port = copy_port = local_port (op) recv_port
+ * \endcode
+ *        element-wise, where (op) is the reduction operator, and identity is its identity
+ *        element. Data movement collectives (allgather and broadcast) reuse the same
+ *        configuration by feeding the identity to local_port.
+ *        The message resides at the same scratchpad address on each lane.
+ */
+struct RingCollAttr {
+  /*!
+   * \brief The number of lanes on the ring. Lane i is bit i of SS_CONTEXT.
+   */
+  int lanes;
+  /*!
+   * \brief The input port of the local operand.
+   */
+  int local_port;
+  /*!
+   * \brief The input port fed by the left neighbor.
+   */
+  int recv_port;
+  /*!
+   * \brief The output port transferred to the right (or left) neighbor.
+   */
+  int out_port;
+  /*!
+   * \brief The output port duplicating out_port, written back to the scratchpad.
+   */
+  int copy_port;
+  /*!
+   * \brief The data type of each element in bytes.
+   */
+  int dtype{8};
+  /*!
+   * \brief The scratchpad address of the message on each lane.
+   */
+  uint64_t addr;
+  /*!
+   * \brief The number of elements of the whole message.
+   */
+  uint64_t n;
+  /*!
+   * \brief The identity element of the reduction operator.
+   */
+  uint64_t identity{0};
+  /*!
+   * \brief The algorithm of the collective.
+   */
+  CollectiveAlgo algo{DCA_Auto};
+};
+
+/*! \brief The bitmask of all the lanes on the ring. */
+DSA_INLINE uint64_t _COLL_ALL_LANES(const RingCollAttr *rc) {
+  return rc->lanes >= 64 ? ~0ull : (1ull << rc->lanes) - 1;
+}
+
+/*!
+ * \brief The chunks [first, first+count) when the message is evenly cut into one chunk
+ *        per lane. As the range may wrap around the end of the message, it is returned
+ *        as up to two segments of addresses and lengths.
+ * \return The total number of elements in the range.
+ */
+DSA_INLINE uint64_t _COLL_RANGE(const RingCollAttr *rc, int first, int count,
+                            uint64_t addr[2], uint64_t len[2]) {
+  uint64_t chunk = (rc->n + rc->lanes - 1) / rc->lanes;
+  int last = first + count;
+  int ends[2] = {last < rc->lanes ? last : rc->lanes, last - rc->lanes};
+  int begins[2] = {first, 0};
+  uint64_t total = 0;
+  for (int p = 0; p < 2; ++p) {
+    uint64_t lo = begins[p] * chunk < rc->n ? begins[p] * chunk : rc->n;
+    uint64_t hi = ends[p] > 0 && ends[p] * chunk < rc->n ? ends[p] * chunk : rc->n;
+    addr[p] = rc->addr + lo * rc->dtype;
+    len[p] = ends[p] > begins[p] ? hi - lo : 0;
+    total += len[p];
+  }
+  return total;
+}
+
+/*! \brief Resolve the algorithm to run. Recursive doubling requires 2^k lanes and even chunks. */
+DSA_INLINE CollectiveAlgo _COLL_SELECT(const RingCollAttr *rc) {
+  bool feasible = (rc->lanes & (rc->lanes - 1)) == 0 && rc->n % rc->lanes == 0;
+  if (!feasible || rc->algo == DCA_Ring) {
+    return DCA_Ring;
+  }
+  if (rc->algo == DCA_RecursiveDoubling) {
+    return DCA_RecursiveDoubling;
+  }
+  uint64_t chunk_bytes = rc->n / rc->lanes * rc->dtype;
+  return chunk_bytes < DSA_COLL_RD_THRESHOLD ? DCA_RecursiveDoubling : DCA_Ring;
+}
+
+/*! \brief Feed the identity element to the given port. */
+DSA_INLINE void _COLL_IDENTITY(const RingCollAttr *rc, int port, uint64_t len) {
+  SS_CONST(port, rc->identity, len, rc->dtype);
+}
+
+/*! \brief The flags of a step on the ring. */
+enum CollectiveStep {
+  DCS_ReadLocal = 1,     // Read local_port from the range, o.w. feed the identity
+  DCS_RecvIdentity = 2,  // Feed the identity to recv_port, o.w. it is fed by the left neighbor
+  DCS_XferRight = 4,     // Transfer out_port to the right neighbor
+  DCS_XferLeft = 8,      // Transfer out_port to the left neighbor, o.w. discard it
+  DCS_WriteBack = 16,    // Write copy_port back to the range, o.w. discard it
+};
+
+/*!
+ * \brief One step of the ring on the chunks [first, first+count), issued to the lanes of
+ *        the current context. Refer CollectiveStep for the flags.
+ * \note Only the scratchpad accesses are split by the wrap-around of the range; the ports
+ *       are FIFOs, so the transfers between lanes are issued as a whole.
+ */
+DSA_INLINE void _COLL_STEP(const RingCollAttr *rc, int first, int count, int flags) {
+  uint64_t addr[2], len[2];
+  uint64_t n = _COLL_RANGE(rc, first, count, addr, len);
+  if (flags & DCS_ReadLocal) {
+    for (int p = 0; p < 2; ++p) {
+      if (len[p]) {
+        SS_1D_READ(addr[p], len[p] * rc->dtype, rc->local_port, DP_NoPadding, DMT_SPAD, rc->dtype);
+      }
+    }
+  } else {
+    _COLL_IDENTITY(rc, rc->local_port, n);
+  }
+  if (flags & DCS_RecvIdentity) {
+    _COLL_IDENTITY(rc, rc->recv_port, n);
+  }
+  if (flags & DCS_XferRight) {
+    SS_XFER(rc->out_port, rc->recv_port, n, DLT_Right, rc->dtype);
+  } else if (flags & DCS_XferLeft) {
+    SS_XFER(rc->out_port, rc->recv_port, n, DLT_Left, rc->dtype);
+  } else {
+    SS_GARBAGE_GENERAL(rc->out_port, n, rc->dtype);
+  }
+  if (flags & DCS_WriteBack) {
+    for (int p = 0; p < 2; ++p) {
+      if (len[p]) {
+        SS_1D_WRITE(rc->copy_port, addr[p], len[p] * rc->dtype, DMT_SPAD, rc->dtype);
+      }
+    }
+  } else {
+    SS_GARBAGE_GENERAL(rc->copy_port, n, rc->dtype);
+  }
+}
+
+/*!
+ * \brief Ring reduce-scatter. After L steps, lane i holds the reduced i-th chunk.
+ *        If chain is set, the last step also forwards the reduced chunk to the right,
+ *        which is the first step of a ring allgather.
+ */
+DSA_INLINE void _COLL_RING_REDUCE_SCATTER(const RingCollAttr *rc, bool chain) {
+  int L = rc->lanes;
+  for (int s = 0; s < L; ++s) {
+    for (int i = 0; i < L; ++i) {
+      bool last = s == L - 1;
+      int flags = DCS_ReadLocal;
+      flags |= s == 0 ? DCS_RecvIdentity : 0;
+      flags |= !last || chain ? DCS_XferRight : 0;
+      flags |= last ? DCS_WriteBack : 0;
+      SS_CONTEXT(1ull << i);
+      _COLL_STEP(rc, ((i - s - 1) % L + 2 * L) % L, 1, flags);
+    }
+  }
+}
+
+/*!
+ * \brief Ring allgather, where lane i owns the i-th chunk.
+ *        If chained, the owned chunks are already in flight to the right.
+ */
+DSA_INLINE void _COLL_RING_ALLGATHER(const RingCollAttr *rc, bool chained) {
+  int L = rc->lanes;
+  for (int t = chained ? 1 : 0; t < L; ++t) {
+    for (int i = 0; i < L; ++i) {
+      int flags = t == 0 ? DCS_ReadLocal | DCS_RecvIdentity | DCS_XferRight
+                         : DCS_WriteBack | (t != L - 1 ? DCS_XferRight : 0);
+      SS_CONTEXT(1ull << i);
+      _COLL_STEP(rc, ((i - t) % L + L) % L, 1, flags);
+    }
+  }
+}
+
+/*!
+ * \brief Shift the chunks [first, first+count) on each lane of the current context by h
+ *        lanes to the right. The intermediate lanes forward the chunks by feeding the identity
+ *        to local_port. The receiver writes the chunks [recv, recv+count) back, combined with
+ *        its own copy if combine is set.
+ */
+DSA_INLINE void _COLL_SHIFT(const RingCollAttr *rc, int h, int first, int recv, int count, bool combine) {
+  _COLL_STEP(rc, first, count, DCS_ReadLocal | DCS_RecvIdentity | DCS_XferRight);
+  for (int hop = 1; hop < h; ++hop) {
+    _COLL_STEP(rc, first, count, DCS_XferRight);
+  }
+  _COLL_STEP(rc, recv, count, (combine ? DCS_ReadLocal : 0) | DCS_WriteBack);
+}
+
+/*!
+ * \brief Wait for the scratchpad streams of a round, before the next one reads them.
+ */
+DSA_INLINE void _COLL_BARRIER() {
+  REG barrier((uint64_t) (1 << DBF_SPadStreams));
+  SS_WAIT(barrier);
+}
+
+/*!
+ * \brief Recursive-doubling allreduce. In the k-th round, each lane combines its partial
+ *        result with the one 2^k lanes to its left, so that after log2(L) rounds each
+ *        partial result covers the whole ring. Each round is uniform across the lanes,
+ *        so the commands are broadcast to all the lanes.
+ */
+DSA_INLINE void _COLL_RD_ALLREDUCE(const RingCollAttr *rc) {
+  SS_CONTEXT(_COLL_ALL_LANES(rc));
+  for (int h = 1; h < rc->lanes; h <<= 1) {
+    // The arriving partial result is combined in place, after this round reads it out.
+    _COLL_SHIFT(rc, h, 0, 0, rc->lanes, true);
+    _COLL_BARRIER();
+  }
+}
+
+/*!
+ * \brief Recursive-doubling allgather. Before the round of distance h, lane i holds the h
+ *        chunks ending at its own, and ships them h lanes to the right.
+ */
+DSA_INLINE void _COLL_RD_ALLGATHER(const RingCollAttr *rc) {
+  int L = rc->lanes;
+  for (int h = 1; h < L; h <<= 1) {
+    for (int i = 0; i < L; ++i) {
+      SS_CONTEXT(1ull << i);
+      _COLL_SHIFT(rc, h, ((i - h + 1) % L + L) % L, ((i - 2 * h + 1) % L + 2 * L) % L, h, false);
+    }
+    _COLL_BARRIER();
+  }
+}
+
+/*!
+ * \brief Reduce the message across all the lanes, and leave the result on every lane.
+ */
+DSA_INLINE void SS_ALLREDUCE(const RingCollAttr *rc) {
+  if (rc->lanes <= 1) {
+    return;
+  }
+  if (_COLL_SELECT(rc) == DCA_RecursiveDoubling) {
+    _COLL_RD_ALLREDUCE(rc);
+  } else {
+    _COLL_RING_REDUCE_SCATTER(rc, true);
+    _COLL_RING_ALLGATHER(rc, true);
+  }
+  SS_CONTEXT(_COLL_ALL_LANES(rc));
+}
+
+/*!
+ * \brief Reduce the message across all the lanes, and leave the reduced i-th chunk on lane i.
+ * \note Recursive halving requires exchanging with non-neighbor lanes, so only the
+ *       ring variant is provided regardless of the algo attribute.
+ */
+DSA_INLINE void SS_REDUCE_SCATTER(const RingCollAttr *rc) {
+  if (rc->lanes <= 1) {
+    return;
+  }
+  _COLL_RING_REDUCE_SCATTER(rc, false);
+  SS_CONTEXT(_COLL_ALL_LANES(rc));
+}
+
+/*!
+ * \brief Gather the i-th chunk of lane i to all the lanes.
+ */
+DSA_INLINE void SS_ALLGATHER(const RingCollAttr *rc) {
+  if (rc->lanes <= 1) {
+    return;
+  }
+  if (_COLL_SELECT(rc) == DCA_RecursiveDoubling) {
+    _COLL_RD_ALLGATHER(rc);
+  } else {
+    _COLL_RING_ALLGATHER(rc, false);
+  }
+  SS_CONTEXT(_COLL_ALL_LANES(rc));
+}
+
+/*!
+ * \brief Broadcast the message on the root lane to all the other lanes.
+ *        The ring variant pipelines the message through L-1 lanes to the right.
+ *        As a neighbor-only ring has no recursive-doubling form of broadcast, the other
+ *        variant sends the message both ways around the ring, which halves the hops.
+ */
+DSA_INLINE void SS_BROADCAST(const RingCollAttr *rc, int root) {
+  int L = rc->lanes;
+  if (L <= 1) {
+    return;
+  }
+  bool split = _COLL_SELECT(rc) == DCA_RecursiveDoubling;
+  int right = split ? L / 2 : L - 1;
+  int left = L - 1 - right;
+  SS_CONTEXT(1ull << root);
+  SS_1D_READ(rc->addr, rc->n * rc->dtype, rc->local_port, DP_NoPadding, DMT_SPAD, rc->dtype);
+  _COLL_IDENTITY(rc, rc->recv_port, rc->n);
+  SS_XFER(rc->out_port, rc->recv_port, rc->n, DLT_Right, rc->dtype);
+  if (left) {
+    SS_XFER(rc->copy_port, rc->recv_port, rc->n, DLT_Left, rc->dtype);
+  } else {
+    SS_GARBAGE_GENERAL(rc->copy_port, rc->n, rc->dtype);
+  }
+  for (int d = 1; d <= right; ++d) {
+    SS_CONTEXT(1ull << ((root + d) % L));
+    _COLL_STEP(rc, 0, L, DCS_WriteBack | (d != right ? DCS_XferRight : 0));
+  }
+  for (int d = 1; d <= left; ++d) {
+    SS_CONTEXT(1ull << ((root - d + L) % L));
+    _COLL_STEP(rc, 0, L, DCS_WriteBack | (d != left ? DCS_XferLeft : 0));
+  }
+  SS_CONTEXT(_COLL_ALL_LANES(rc));
+}
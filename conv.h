@@ -0,0 +1,211 @@
+/*!
+ * \file conv.h
+ * \author PolyArch Research Lab
+ * \brief Convolution and stencil kernels without im2col. The windows are expressed as 3D
+ *        streams of row segments: the configuration slides each segment through a window
+ *        of K elements, so every input element is read once per window row instead of
+ *        once per tap. The ports should be compile-time constants.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The ports of the convolutions.
+ *        For each output row, the configuration receives the number of window rows n on
+ *        in_taps, and then n row segments of OW+K-1 elements on in_row. With a segment and
+ *        the weight vector of its window row on in_w, a vector port of K lanes repeated for
+ *        each of the OW outputs, it accumulates sum_kx w[kx]*seg[ox+kx] over the n segments,
+ *        and emits the OW results of the output row to out.
+ */
+struct ConvPorts {
+  int in_row, in_w, in_taps, out;
+};
+
+/*!
+ * \brief A 2D convolution of an h x w input and a k x k filter, with pad zeros on each side.
+ *        The vertical padding is done by the streams, which clip the window rows at the
+ *        borders. The horizontal padding is in the layout: in points to the column -pad of
+ *        the row 0, and the pad columns of each row are expected to be zeros.
+ */
+struct ConvAttr {
+  /*!
+   * \brief The input, and the elements between two rows.
+   */
+  REG in;
+  uint64_t h, w, pitch;
+  /*!
+   * \brief The k x k filter in the row-major order.
+   */
+  REG weight;
+  int k;
+  int pad{0};
+  /*!
+   * \brief The output, and the elements between two rows.
+   */
+  REG out;
+  uint64_t out_pitch;
+  int dtype{4};
+  int memory{DMT_DMA};
+  /*!
+   * \brief The padding of each row segment, which completes the last vector of the segment.
+   */
+  Padding padding{DP_PostStrideZero};
+};
+
+/*! \brief The height of the output. */
+inline uint64_t CONV_OUT_H(const ConvAttr *ca) {
+  return ca->h + 2 * ca->pad - ca->k + 1;
+}
+
+/*! \brief The width of the output. */
+inline uint64_t CONV_OUT_W(const ConvAttr *ca) {
+  return ca->w + 2 * ca->pad - ca->k + 1;
+}
+
+/*!
+ * \brief Feed the windows of n3d consecutive output rows. The window of the first output row
+ *        starts from the input row `row` and the filter row `w_row`, and has n2d rows. For each
+ *        next output row, the input row advances by in_step, the filter row by w_step,
+ *        and the window rows by delta, i.e. the triangular windows at the borders.
+ */
+DSA_INLINE void _CONV_WINDOWS(const ConvAttr *ca, const ConvPorts *p, REG in, REG weight,
+                              uint64_t row, int64_t in_step, int64_t w_row, int64_t w_step,
+                              uint64_t n2d, int64_t delta, uint64_t n3d) {
+  if (!n3d) {
+    return;
+  }
+  int d = ca->dtype;
+  uint64_t ow = CONV_OUT_W(ca);
+  INSTANTIATE_3D_STREAM(in.value + row * ca->pitch * d, (uint64_t) 1, ow + ca->k - 1,
+                        ca->pitch, (uint64_t) 0, n2d,
+                        (uint64_t) 0, (uint64_t) 0, (uint64_t) 0, (uint64_t) delta,
+                        (uint64_t) (in_step * (int64_t) ca->pitch), n3d,
+                        p->in_row, ca->padding, DSA_Access, DMO_Read, ca->memory, d, 0);
+  SS_REPEAT_PORT(p->in_w, ow);
+  INSTANTIATE_3D_STREAM(weight.value + w_row * ca->k * d, (uint64_t) 1, (uint64_t) ca->k,
+                        (uint64_t) ca->k, (uint64_t) 0, n2d,
+                        (uint64_t) 0, (uint64_t) 0, (uint64_t) 0, (uint64_t) delta,
+                        (uint64_t) (w_step * ca->k), n3d,
+                        p->in_w, DP_NoPadding, DSA_Access, DMO_Read, DMT_DMA, d, 0);
+  // The number of window rows of each output row, n2d + i*delta.
+  INSTANTIATE_1D_STREAM(n2d, (uint64_t) delta, n3d, p->in_taps, DP_NoPadding,
+                        DSA_Generate, DMO_Read, DMT_DMA, 1, 8);
+}
+
+/*!
+ * \brief A 2D convolution of the given input and filter, in three regions of output rows:
+ *        the top pad rows, whose windows grow by a row each; the rows with full windows;
+ *        and the bottom pad rows, whose windows shrink by a row each.
+ *        It requires pad < k <= h.
+ */
+DSA_INLINE void _CONV2D(const ConvAttr *ca, REG in, REG weight, REG out, const ConvPorts *p) {
+  int k = ca->k, pad = ca->pad;
+  // The top rows start from the input row 0, and the filter row pad-oy.
+  _CONV_WINDOWS(ca, p, in, weight, 0, 0, pad, -1, k - pad, 1, pad);
+  _CONV_WINDOWS(ca, p, in, weight, 0, 1, 0, 0, k, 0, ca->h - k + 1);
+  _CONV_WINDOWS(ca, p, in, weight, ca->h - k + 1, 1, 0, 0, k - 1, -1, pad);
+  INSTANTIATE_2D_STREAM(out, (uint64_t) 1, CONV_OUT_W(ca), ca->out_pitch, (uint64_t) 0,
+                        CONV_OUT_H(ca), p->out, DP_NoPadding, DSA_Access, DMO_Write,
+                        ca->memory, ca->dtype, 0);
+}
+
+/*!
+ * \brief out = in * weight, a 2D convolution.
+ */
+DSA_INLINE void SS_CONV2D(const ConvAttr *ca, const ConvPorts *p) {
+  _CONV2D(ca, ca->in, ca->weight, ca->out, p);
+}
+
+/*!
+ * \brief A depthwise convolution, where each of the channels is convolved with its own
+ *        filter. The channels of the input and the output are h*pitch and
+ *        CONV_OUT_H*out_pitch elements apart, and the filters are k*k elements apart.
+ */
+DSA_INLINE void SS_DEPTHWISE_CONV2D(const ConvAttr *ca, uint64_t channels, const ConvPorts *p) {
+  int d = ca->dtype;
+  for (uint64_t c = 0; c < channels; ++c) {
+    _CONV2D(ca, ca->in.value + c * ca->h * ca->pitch * d,
+            ca->weight.value + c * ca->k * ca->k * d,
+            ca->out.value + c * CONV_OUT_H(ca) * ca->out_pitch * d, p);
+  }
+}
+
+/*!
+ * \brief The ports of the stencils.
+ *        For each interior row, the configuration receives the row segments of the
+ *        same plane on in_rows, the rows above, at, and below; for the 7-point stencil, it
+ *        also receives the row segments of the planes before and after on in_planes.
+ *        It emits c0*u[x] + c1*(sum of the neighbors of x) for each interior x to out,
+ *        where the coefficients come from in_c0 and in_c1, one per output.
+ */
+struct StencilPorts {
+  int in_rows, in_planes, in_c0, in_c1, out;
+};
+
+/*!
+ * \brief A stencil over a grid, whose boundary is kept as it is.
+ */
+struct StencilAttr {
+  /*!
+   * \brief The input and the output grids, with the same layout.
+   */
+  REG in, out;
+  /*!
+   * \brief The dimensions of the grid, where d is 1 for a 2D grid.
+   */
+  uint64_t d{1}, h, w;
+  /*!
+   * \brief The coefficients as the bits of dtype.
+   */
+  uint64_t c0, c1;
+  int dtype{8};
+  int memory{DMT_DMA};
+};
+
+/*!
+ * \brief Feed the interior rows of the plane z, where each row gets the rows from row-first
+ *        in steps of step, n of them, to the port.
+ */
+DSA_INLINE void _STENCIL_ROWS(const StencilAttr *sa, uint64_t z, int64_t first, int64_t step,
+                              uint64_t n, int port) {
+  uint64_t plane = sa->h * sa->w;
+  INSTANTIATE_3D_STREAM(sa->in.value + (z * plane + sa->w + first) * sa->dtype,
+                        (uint64_t) 1, sa->w, (uint64_t) step, (uint64_t) 0, n,
+                        (uint64_t) 0, (uint64_t) 0, (uint64_t) 0, (uint64_t) 0,
+                        sa->w, sa->h - 2,
+                        port, DP_NoPadding, DSA_Access, DMO_Read, sa->memory, sa->dtype, 0);
+}
+
+/*! \brief Write the interior of the plane z. */
+DSA_INLINE void _STENCIL_WRITE(const StencilAttr *sa, uint64_t z, const StencilPorts *p) {
+  uint64_t n = (sa->h - 2) * (sa->w - 2);
+  SS_CONST(p->in_c0, sa->c0, n, sa->dtype);
+  SS_CONST(p->in_c1, sa->c1, n, sa->dtype);
+  INSTANTIATE_2D_STREAM(sa->out.value + (z * sa->h * sa->w + sa->w + 1) * sa->dtype,
+                        (uint64_t) 1, sa->w - 2, sa->w, (uint64_t) 0, sa->h - 2,
+                        p->out, DP_NoPadding, DSA_Access, DMO_Write, sa->memory, sa->dtype, 0);
+}
+
+/*!
+ * \brief The 5-point stencil over an h x w grid. All the interior rows are a single 3D stream.
+ */
+DSA_INLINE void SS_STENCIL5(const StencilAttr *sa, const StencilPorts *p) {
+  _STENCIL_ROWS(sa, 0, -(int64_t) sa->w, sa->w, 3, p->in_rows);
+  _STENCIL_WRITE(sa, 0, p);
+}
+
+/*!
+ * \brief The 7-point stencil over a d x h x w grid, a 3D stream per interior plane for the
+ *        rows of the same plane, and one for the rows of the planes before and after.
+ */
+DSA_INLINE void SS_STENCIL7(const StencilAttr *sa, const StencilPorts *p) {
+  int64_t plane = sa->h * sa->w;
+  for (uint64_t z = 1; z + 1 < sa->d; ++z) {
+    _STENCIL_ROWS(sa, z, -(int64_t) sa->w, sa->w, 3, p->in_rows);
+    _STENCIL_ROWS(sa, z, -plane, 2 * plane, 2, p->in_planes);
+    _STENCIL_WRITE(sa, z, p);
+  }
+}
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+
+"""The static cost report of the DSA instructions of each call site in a compiled kernel.
+
+The kernel should be compiled with -g, so that the instructions expanded from the inlined
+SS_* wrappers are attributed back to the source lines calling them. The counts are static,
+i.e. the instructions in the binary, not the ones executed. Each stream instruction ends a
+launch, and the instructions of a call site are split evenly among its launches.
+A launch is flagged if issuing it takes longer than streaming the given payload at the
+bandwidth of spec.h, i.e. the payload is too small to hide its setup.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+root = os.path.dirname(os.path.abspath(__file__))
+
+streams = ['ss_lin_strm', 'ss_ind_strm', 'ss_wr_rd']
+
+def mnemonics(isa):
+    """The DSA mnemonics in isa.ext."""
+    res = []
+    with open(isa) as f:
+        for raw in f.readlines():
+            if '#' in raw:
+                raw = raw[:raw.index('#')]
+            raw = raw.split()
+            if raw:
+                res.append(raw[0])
+    return res
+
+def spec(header):
+    """The numeric macros in spec.h, the first definition of each."""
+    res = {}
+    with open(header) as f:
+        for raw in f.readlines():
+            match = re.match(r'\s*#define\s+(\w+)\s+\(?\s*(\d+)\s*\)?\s*(//.*)?$', raw)
+            if match and match.group(1) not in res:
+                res[match.group(1)] = int(match.group(2))
+    return res
+
+def disassemble(objdump, binary):
+    """The disassembly with the source lines and the inlining frames."""
+    cmd = [objdump, '-d', '-l', '--inlines', '--no-show-raw-insn', binary]
+    return subprocess.check_output(cmd, universal_newlines=True).splitlines()
+
+location = re.compile(r'^(inlined by )?(\S+):(\d+)( \(.*\))?$')
+instruction = re.compile(r'^\s*[0-9a-f]+:\s+(\S+)')
+
+def attribute(lines, site):
+    """Yield (call site, function, mnemonic) of each instruction.
+    The call site is the outermost frame whose file matches the site pattern, or the
+    innermost frame if none matches."""
+    func = None
+    inner = None
+    chain = []
+    fresh = True
+    for raw in lines:
+        raw = raw.rstrip()
+        match = instruction.match(raw)
+        if match:
+            frames = [inner] + chain if inner else chain
+            where = None
+            for frame in reversed(frames):
+                if site.search(frame[0]):
+                    where = frame
+                    break
+            where = where or (frames[0] if frames else ('?', 0))
+            fresh = True
+            yield '%s:%d' % (os.path.basename(where[0]), where[1]), func, match.group(1)
+            continue
+        match = location.match(raw)
+        if match:
+            if fresh:
+                chain = []
+                fresh = False
+            frame = (match.group(2), int(match.group(3)))
+            if match.group(1):
+                chain.append(frame)
+            else:
+                inner = frame
+            continue
+        match = re.match(r'^[0-9a-f]+ <(.*)>:$', raw)
+        if match:
+            func = match.group(1)
+            inner = None
+            chain = []
+
+def report(insts, dsa, width, cycles, payload):
+    """The cost of each call site, in the order of their first instruction."""
+    sites = {}
+    for where, func, mn in insts:
+        key = (func, where)
+        if key not in sites:
+            sites[key] = {'function': func, 'site': where, 'launches': 0, 'host': 0}
+            for i in dsa:
+                sites[key][i] = 0
+        entry = sites[key]
+        if mn in dsa:
+            entry[mn] += 1
+            entry['launches'] += mn in streams
+        else:
+            entry['host'] += 1
+    res = []
+    for entry in sites.values():
+        total = entry['host'] + sum(entry[i] for i in dsa)
+        if total == entry['host']:
+            continue
+        launches = max(entry['launches'], 1)
+        entry['insts_per_launch'] = total / launches
+        entry['setup_cycles'] = entry['insts_per_launch'] * cycles
+        entry['break_even_bytes'] = entry['setup_cycles'] * width
+        entry['flagged'] = entry['launches'] > 0 and entry['break_even_bytes'] > payload
+        res.append(entry)
+    return res
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('binary', help='The kernel compiled with -g, or its disassembly by '
+                        '`objdump -d -l --inlines` with --dump.')
+    parser.add_argument('--objdump', default=os.getenv('OBJDUMP', 'riscv64-unknown-linux-gnu-objdump'))
+    parser.add_argument('--dump', action='store_true', help='The input is a disassembly.')
+    parser.add_argument('--isa', default=os.path.join(root, 'isa.ext'))
+    parser.add_argument('--spec', default=os.path.join(root, 'spec.h'))
+    parser.add_argument('--site', default='.', help='The pattern of the files of the call '
+                        'sites, e.g. gemm.h to attribute the streams of SS_GEMM to its lines.')
+    parser.add_argument('--bytes', type=int, default=512,
+                        help='The payload of a launch, to which the setup is compared.')
+    parser.add_argument('--width', default='MEM_WIDTH',
+                        help='The macro in spec.h of the bytes streamed per cycle.')
+    parser.add_argument('--inst-cycles', type=float, default=1.0,
+                        help='The cycles of the host to issue an instruction.')
+    parser.add_argument('--json', action='store_true', help='Print a record per call site.')
+    args = parser.parse_args()
+
+    dsa = mnemonics(args.isa)
+    width = spec(args.spec)[args.width]
+    if args.dump:
+        with open(args.binary) as f:
+            lines = f.read().splitlines()
+    else:
+        lines = disassemble(args.objdump, args.binary)
+    sites = report(attribute(lines, re.compile(args.site)), dsa, width, args.inst_cycles,
+                   args.bytes)
+
+    if args.json:
+        for entry in sites:
+            print(json.dumps(entry))
+    else:
+        cols = ['ss_cfg_param', 'ss_cfg_port', 'launches', 'host']
+        print('%-32s %9s %8s %8s %6s %10s %10s' %
+              ('site', 'cfg_param', 'cfg_port', 'launches', 'host', 'per-launch', 'break-even'))
+        for entry in sites:
+            print('%-32s %9d %8d %8d %6d %10.1f %9dB%s' %
+                  tuple([entry['site']] + [entry[i] for i in cols] +
+                        [entry['insts_per_launch'], entry['break_even_bytes'],
+                         ' *' if entry['flagged'] else '']))
+    flagged = sum(entry['flagged'] for entry in sites)
+    if flagged:
+        sys.stderr.write('%d call site(s) issue longer than streaming %d bytes at %d bytes/cycle.\n' %
+                         (flagged, args.bytes, width))
+
+if __name__ == '__main__':
+    main()
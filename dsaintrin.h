@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include <assert.h>
+#include <stddef.h>
+
 #include "dsa-ext/spec.h"
 #include "dsa-ext/rf.h"
 
@@ -26,6 +29,22 @@ struct REG {
   REG(void *value_) : value((uint64_t)(value_)) {}
 };
 
+#ifdef DSA_SOFT_MODEL
+
+#include "soft_model.h"
+
+#define INTRINSIC_RRI(mn, a, b, c) _DSA_MODEL(mn, a, b, c)
+
+#define INTRINSIC_RI(mn, a, b) _DSA_MODEL(mn, a, 0, b)
+
+#define INTRINSIC_R(mn, a) _DSA_MODEL(mn, a, 0, 0)
+
+#define INTRINSIC_DI(mn, a, b) a = _DSA_MODEL(mn, 0, 0, b);
+
+#define INTRINSIC_DRI(mn, a, b, c) a = _DSA_MODEL(mn, b, 0, c);
+
+#else
+
 #define INTRINSIC_RRI(mn, a, b, c) \
   __asm__ __volatile__(mn " %0, %1, %2" : : "r"(a), "r"(b), "i"(c))
 
@@ -39,6 +58,14 @@ struct REG {
 #define INTRINSIC_DRI(mn, a, b, c) \
    __asm__ __volatile__(mn " %0, %1, %2" : "=r"(a) : "r"(b), "i"(c));
 
+#endif
+
+/*!
+ * \brief Ports are encoded as immediates of the instructions, so a wrapper taking ports as
+ *        arguments should be inlined into the caller where the ports are constants.
+ */
+#define DSA_INLINE __attribute__((always_inline)) inline
+
 #define DIV(a, b) ((a) / (b))
 #define SUB(a, b) ((a) - (b))
 #define SHL(a, b) ((a) << (b))
@@ -84,6 +111,39 @@ inline void SS_1D_WRITE(int port,
                         source, wbytes, 0);
 }
 
+/*!
+ * \brief The sentinel of the given data type in bytes, i.e. only the sign bit set.
+ */
+inline uint64_t SENTINAL_OF(int dtype) {
+  return dtype >= 8 ? SENTINAL : ((uint64_t) 1) << (dtype * 8 - 1);
+}
+
+/*!
+ * \brief addr[0:n] -> port, where n is the position of the first SENTINAL_OF(wbytes).
+ *        Use DP_PostSentinel to forward the sentinel to the port as the end of the list.
+ * \param max_bytes The stream ends here if no sentinel is seen before.
+ */
+inline void SS_1D_READ_UNTIL(REG addr,
+                             REG max_bytes,
+                             int port,
+                             Padding padding,
+                             MemoryType source,
+                             int wbytes = 1) {
+  INSTANTIATE_1D_STREAM(addr, 1, max_bytes / wbytes, port, padding,
+                        DSA_Access, DMO_Read, source, wbytes, 0, DST_SentinelStream);
+}
+
+/*!
+ * \brief n rows of sentinel-terminated lists, addr + i*stride -> port.
+ *        Use DP_PostSentinel to forward the sentinel of each row to the port.
+ * \param max_bytes Each row ends here if no sentinel is seen before.
+ */
+inline void SS_2D_READ_UNTIL(REG addr, REG stride, REG max_bytes, REG n, int port,
+                             Padding padding, MemoryType source, int wbytes = 1) {
+  INSTANTIATE_2D_STREAM(addr, 1, max_bytes / wbytes, stride / wbytes, (uint64_t) 0, n,
+                        port, padding, DSA_Access, DMO_Read, source, wbytes, 0, DST_Sentinel1D);
+}
+
 /*!
  * \brief The semantics is similar to DMA_READ_STRETCH but for scratchpad read.
  */
@@ -157,8 +217,7 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
  */
 #define SS_GARBAGE_GENERAL(output_port, num_elem, elem_size)   \
   do {                                                         \
-    auto bytes_ = bytes;                                       \
-    INSTANTIATE_1D_STREAM(0, elem_size, num_elem, port,        \
+    INSTANTIATE_1D_STREAM((uint64_t) 0, elem_size, num_elem, output_port, \
                           DP_NoPadding, DSA_Access, DMO_Write, \
                           DMT_DMA, elem_size, 0);              \
   } while (false)
@@ -192,6 +251,92 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
   INSTANTIATE_1D_INDIRECT(operand_port, otype, idx_port, itype, start, stride, len, memory, \
                           operation, false, false)
 
+/*!
+ * \brief Gather n fields of the struct at each index, a[b[i]].f, each field to its own port.
+ *        The fields should be of the same size, a power of two dividing the size of the struct,
+ *        and within the first 256 bytes of the struct.
+ * \param offsets The byte offsets of the fields.
+ * \param ports The destination port of each field.
+ * \param fbytes The size of each field.
+ * \param sbytes The size of the struct.
+ */
+inline void SS_GATHER_FIELDS_GENERAL(int n, const int *offsets, const int *ports, int fbytes,
+                                     int sbytes, int idx_port, int itype, REG start, REG len,
+                                     int memory) {
+  assert((fbytes & (fbytes - 1)) == 0 && sbytes % fbytes == 0);
+  for (int i = 0; i < n; ++i) {
+    assert(offsets[i] >= 0 && offsets[i] < 256);
+  }
+  INSTANTIATE_1D_INDIRECT(ports[0], fbytes, idx_port, itype, start, sbytes / fbytes, len, memory,
+                          DMO_Read, false, false, 0, false, OFL_MASK(n, offsets, ports));
+}
+
+#define _FIELD_BYTES(T, f) sizeof(((T*) 0)->f)
+
+/*!
+ * \brief The stride of the gather is sizeof(T) in the fields of f1, so the fields should be of a
+ *        power-of-two size dividing sizeof(T), and the offset of each field f fits in 8 bits.
+ */
+#define _GATHER_FIELDS_CHECK(T, f1)                                                          \
+  static_assert((_FIELD_BYTES(T, f1) & (_FIELD_BYTES(T, f1) - 1)) == 0,                      \
+                "Fields of a size not a power of two!");                                     \
+  static_assert(sizeof(T) % _FIELD_BYTES(T, f1) == 0, "Struct not a multiple of the fields!")
+
+#define _GATHER_FIELD_CHECK(T, f1, f)                                                        \
+  static_assert(offsetof(T, f) < 256, "Field beyond the first 256 bytes!");                  \
+  static_assert(_FIELD_BYTES(T, f) == _FIELD_BYTES(T, f1), "Fields of different sizes!")
+
+/*!
+ * \brief Gather the fields f1..f4 of the struct T at each index to the ports p1..p4.
+ * \param start The address of the array of T.
+ */
+#define SS_GATHER_FIELDS1(T, f1, p1, idx_port, itype, start, len, memory) \
+  do {                                                                   \
+    _GATHER_FIELDS_CHECK(T, f1);                                         \
+    _GATHER_FIELD_CHECK(T, f1, f1);                                      \
+    int __offsets__[] = {(int) offsetof(T, f1)};                         \
+    int __ports__[] = {p1};                                              \
+    SS_GATHER_FIELDS_GENERAL(1, __offsets__, __ports__, _FIELD_BYTES(T, f1), sizeof(T), \
+                             idx_port, itype, start, len, memory);       \
+  } while (false)
+
+#define SS_GATHER_FIELDS2(T, f1, p1, f2, p2, idx_port, itype, start, len, memory) \
+  do {                                                                   \
+    _GATHER_FIELDS_CHECK(T, f1);                                         \
+    _GATHER_FIELD_CHECK(T, f1, f1);                                      \
+    _GATHER_FIELD_CHECK(T, f1, f2);                                      \
+    int __offsets__[] = {(int) offsetof(T, f1), (int) offsetof(T, f2)};  \
+    int __ports__[] = {p1, p2};                                          \
+    SS_GATHER_FIELDS_GENERAL(2, __offsets__, __ports__, _FIELD_BYTES(T, f1), sizeof(T), \
+                             idx_port, itype, start, len, memory);       \
+  } while (false)
+
+#define SS_GATHER_FIELDS3(T, f1, p1, f2, p2, f3, p3, idx_port, itype, start, len, memory) \
+  do {                                                                   \
+    _GATHER_FIELDS_CHECK(T, f1);                                         \
+    _GATHER_FIELD_CHECK(T, f1, f1);                                      \
+    _GATHER_FIELD_CHECK(T, f1, f2);                                      \
+    _GATHER_FIELD_CHECK(T, f1, f3);                                      \
+    int __offsets__[] = {(int) offsetof(T, f1), (int) offsetof(T, f2), (int) offsetof(T, f3)}; \
+    int __ports__[] = {p1, p2, p3};                                      \
+    SS_GATHER_FIELDS_GENERAL(3, __offsets__, __ports__, _FIELD_BYTES(T, f1), sizeof(T), \
+                             idx_port, itype, start, len, memory);       \
+  } while (false)
+
+#define SS_GATHER_FIELDS4(T, f1, p1, f2, p2, f3, p3, f4, p4, idx_port, itype, start, len, memory) \
+  do {                                                                   \
+    _GATHER_FIELDS_CHECK(T, f1);                                         \
+    _GATHER_FIELD_CHECK(T, f1, f1);                                      \
+    _GATHER_FIELD_CHECK(T, f1, f2);                                      \
+    _GATHER_FIELD_CHECK(T, f1, f3);                                      \
+    _GATHER_FIELD_CHECK(T, f1, f4);                                      \
+    int __offsets__[] = {(int) offsetof(T, f1), (int) offsetof(T, f2),   \
+                         (int) offsetof(T, f3), (int) offsetof(T, f4)};  \
+    int __ports__[] = {p1, p2, p3, p4};                                  \
+    SS_GATHER_FIELDS_GENERAL(4, __offsets__, __ports__, _FIELD_BYTES(T, f1), sizeof(T), \
+                             idx_port, itype, start, len, memory);       \
+  } while (false)
+
 // ==================== Above are implemented ====================
 
 /*!
@@ -218,6 +363,7 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
  * \param output_port: The source port in the current lane.
  * \param input_port: The destination port in the right lane.
  * \param num_strides: The number of elements to be transfered.
+ * \note The legacy encoding, which is not in isa.ext. Refer SS_XFER.
  */
 #define SS_XFER_LEFT(output_port, input_port, num_strides) \
   __asm__ __volatile__("ss_wr_rd %0, %1, %2" : : "r"(num_strides), "r"(1), "i"((input_port<<6) | (output_port)))
@@ -228,6 +374,7 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
  * \param output_port: The source port in the current lane.
  * \param input_port: The destination port in the right lane.
  * \param num_strides: The number of elements to be transfered.
+ * \note The legacy encoding, which is not in isa.ext. Refer SS_XFER.
  */
 #define SS_XFER_RIGHT(output_port, input_port, num_strides) \
   __asm__ __volatile__("ss_wr_rd %0, %1, %2" : : "r"(num_strides), "r"(2), "i"((input_port<<6) | (output_port)))
@@ -239,6 +386,7 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
  * \param output_port: The source port in the current lane.
  * \param input_port: The destination port in the right lane.
  * \param num_strides: The number of elements to be transfered.
+ * \note The legacy encoding, which is not in isa.ext. Refer SS_XFER.
  */
 #define SS_XFER_LEFT_PAD(output_port, input_port, num_strides) \
   __asm__ __volatile__("ss_wr_rd %0, %1, %2" : : "r"(num_strides), "r"(1 | 4), "i"((input_port<<6) | (output_port)))
@@ -250,6 +398,7 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
  * \param output_port: The source port in the current lane.
  * \param input_port: The destination port in the right lane.
  * \param num_strides: The number of elements to be transfered.
+ * \note The legacy encoding, which is not in isa.ext. Refer SS_XFER.
  */
 #define SS_XFER_RIGHT_PAD(output_port, input_port, num_strides) \
   __asm__ __volatile__("ss_wr_rd %0, %1, %2" : : "r"(num_strides), "r"(2 | 4), "i"((input_port<<6) | (output_port)))
@@ -259,7 +408,8 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
   __asm__ __volatile("ss_rem_port %0, %1, %2" : : "r"(num_elem), "r"(mask), "i"(((output_port<15?output_port:output_port-32)<<7) | (0<<6) | (remote_port<<1) | (0)))
 
 // TODO(@were): Confirm the semantics with @vidushi
-#define SS_IND_REM_SCRATCH(val_port, addr_port, num_elem, scr_base_addr, scratch_type); \
+// NOTE: ss_rem_port is not in isa.ext, nor in the software model.
+#define SS_IND_REM_SCRATCH(val_port, addr_port, num_elem, scr_base_addr, scratch_type) \
   __asm__ __volatile("ss_rem_port %0, %1, %2" : : "r"(num_elem), "r"(scr_base_addr), "i"((val_port<<7) | (scratch_type<<6) | (addr_port<<1) | (1)))
 
 // TODO(@were): Confirm the semantics with @vidushi
@@ -298,16 +448,17 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
  * \param val_num: sizeof(val_type) * val_num together determine the number of bytes to read.
  * \param num_dates: The number of outputs
  * \param is_update_port: Where the operation happens, 0: near storage units, 1: CGRA.
+ * \note ss_cfg_atom_op is not in isa.ext, nor in the software model.
  */
 #define SS_CONFIG_ATOMIC_SCR_OP(addr_type, val_type, output_type, val_num, num_updates, is_update_port)      \
   do {                                                                                                       \
     if (is_update_port == 1) {                                                                               \
-      auto __cfg_imm__ = ((val_type<<4)&0x1ADB0 | (output_type<<2)&0x44C | (addr_type)&0x3);                 \
-      auto __update__  = num_updates | 1<<16;                                                                \
+      auto __cfg_imm__ = (((val_type<<4)&0x1ADB0) | ((output_type<<2)&0x44C) | ((addr_type)&0x3));           \
+      auto __update__  = (num_updates) | (1<<16);                                                            \
       __asm__ __volatile__("ss_cfg_atom_op %0, %1, %2" : : "r"(val_num), "r"(__update__), "i"(__cfg_imm__)); \
     } else {                                                                                                 \
-      auto __update__ = num_updates | 0<<16;                                                                 \
-      auto __cfg_imm__ = ((val_type<<4)&0x1ADB0 | (output_type<<2)&0x44C | (addr_type)&0x3);                 \
+      auto __update__ = (num_updates) | (0<<16);                                                             \
+      auto __cfg_imm__ = (((val_type<<4)&0x1ADB0) | ((output_type<<2)&0x44C) | ((addr_type)&0x3));           \
       __asm__ __volatile__("ss_cfg_atom_op %0, %1, %2" : : "r"(val_num), "r"(__update__), "i"(__cfg_imm__)); \
     }                                                                                                        \
   } while(false)
@@ -322,9 +473,10 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
  * \param iters: The number of iterations.
  * \param opcode: The operation performed in the near storage FU.
  *                TODO(@were): What happens when something happens in CGRA (is_update).
+ * \note ss_atom_op is not in isa.ext, nor in the software model.
  */
 #define SS_ATOMIC_SCR_OP(addr_port, val_port, offset, iters, opcode) \
-  __asm__ __volatile__("ss_atom_op %0, %1, %2" : : "r"(offset | addr_port << 24), "r"(iters), "i"((val_port<<2) | opcode))
+  __asm__ __volatile__("ss_atom_op %0, %1, %2" : : "r"((offset) | ((addr_port) << 24)), "r"(iters), "i"((val_port<<2) | opcode))
 
 /*!
  * \brief Configure an indirect read stream. Something like a[b[i]*k].
@@ -411,11 +563,30 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
 #define PART_CORE_REST_BANK 1
 #define CORE_PART_BANK_REST 2 // this one works only for power of 2 data-structure sizes
 
+/*!
+ * \brief Configure the memory map with a map type known only at runtime.
+ * \param map_type One of the map types above.
+ */
+inline void SS_MEM_MAP(REG part_size, REG active_core_bv, int map_type) {
+  switch (map_type) {
+  case PART_CORE_BANK_REST:
+    SS_CONFIG_MEM_MAP(part_size, active_core_bv, PART_CORE_BANK_REST);
+    break;
+  case PART_CORE_REST_BANK:
+    SS_CONFIG_MEM_MAP(part_size, active_core_bv, PART_CORE_REST_BANK);
+    break;
+  case CORE_PART_BANK_REST:
+    SS_CONFIG_MEM_MAP(part_size, active_core_bv, CORE_PART_BANK_REST);
+    break;
+  }
+}
+
 
 /*!
  * \brief Wait for several elements write to the sratchpad.
  * \param num_rem_writes: 
  * \param scratch_type: 
+ * \note ss_wait_df is not in isa.ext, nor in the software model.
  */
 #define SS_WAIT_DF(num_rem_writes, scratch_type) \
   __asm __volatile__("ss_wait_df %0, %1" : : "r"(num_rem_writes), "i"(scratch_type));
@@ -440,11 +611,6 @@ inline void SS_DMA_2D_WRITE(REG addr, REG stride, REG bytes, REG stretch, REG n,
 #define SS_WAIT_SCR_RD() \
   __asm__ __volatile__("ss_wait t0, t0, 4"); \
 
-// TODO(@were): Confirm this with vidushi.
-//wait for all prior scratch reads to be complete (128*8?)
-#define SS_GLOBAL_WAIT(num_threads) \
-  __asm__ __volatile__("ss_wait %0, t0, 128" :: "r"(num_threads)); \
-
 //wait for all prior scratch reads to be complete (NOT IMPLEMENTED IN SIMULTOR YET)
 #define SS_WAIT_SCR_RD_QUEUED() \
   __asm__ __volatile__("ss_wait t0, t0, 8"); \
@@ -0,0 +1,229 @@
+/*!
+ * \file gemm.h
+ * \author PolyArch Research Lab
+ * \brief A tiled GEMM, C += A*B, with the tiles of B double buffered in the scratchpad.
+ *        The tile sizes come from gemm_tiles.h, generated by `make tune-gemm` for the
+ *        scratchpad of spec.h, or from a conservative default if it is absent or stale.
+ *        The ports should be compile-time constants.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The lanes of the vector ports of the configuration. The tile width should be a
+ *        multiple of it.
+ */
+#ifndef GEMM_VEC
+#define GEMM_VEC 8
+#endif
+
+/*!
+ * \brief The elements of C recurred at a time, the whole vectors buffered by the ports of the
+ *        CGRA. The recurrence of more partial sums than the ports buffer deadlocks, since
+ *        they are all emitted before the first of them is consumed.
+ */
+#ifndef GEMM_RECUR_LEN
+#define GEMM_RECUR_LEN (CGRA_FIFO_LEN / GEMM_VEC * GEMM_VEC)
+#endif
+
+static_assert(GEMM_RECUR_LEN >= GEMM_VEC && GEMM_RECUR_LEN % GEMM_VEC == 0,
+              "GEMM_RECUR_LEN should be whole vectors of GEMM_VEC lanes.");
+
+/*!
+ * \brief The tile sizes of the rows of A and C, the columns of B and C, and the reduction.
+ */
+struct GemmTile {
+  uint64_t tm, tn, tk;
+};
+
+/*!
+ * \brief The matrices are row-major, A is m x k, B is k x n, and C is m x n. The ld* are the
+ *        elements between two rows. n should be a multiple of GEMM_VEC.
+ */
+struct GemmAttr {
+  REG a, b, c;
+  uint64_t m, n, k;
+  uint64_t lda, ldb, ldc;
+  int dtype{8};
+  /*!
+   * \brief The scratchpad of the two buffers of B, 2*tk*tn elements.
+   */
+  REG spad{(uint64_t) 0};
+};
+
+/*!
+ * \brief The ports of the GEMM.
+ *        The configuration receives a[i][kk] on in_a, once per GEMM_VEC lanes of a row of B,
+ *        the row kk of the B tile on in_b, and the partial row i of C on in_c, and emits
+ *        in_c + in_a * in_b to out_c. The partial sums of a slice of a row of C over the
+ *        reduction of a tile are recurred from out_c to in_c. The configuration passes in_pass
+ *        to out_pass, which loads the tiles of B to the scratchpad.
+ */
+struct GemmPorts {
+  int in_a, in_b, in_c, out_c, in_pass, out_pass;
+};
+
+/*!
+ * \brief The shapes are bucketed by each dimension, up to 64, up to 256, and beyond.
+ */
+#define GEMM_BUCKETS 27
+
+/*! \brief The bucket of a dimension. */
+inline int _GEMM_BUCKET(uint64_t x) {
+  return x <= 64 ? 0 : (x <= 256 ? 1 : 2);
+}
+
+/*! \brief The bucket of a shape, the index to GEMM_TILES. */
+inline int GEMM_BUCKET(uint64_t m, uint64_t n, uint64_t k) {
+  return _GEMM_BUCKET(m) * 9 + _GEMM_BUCKET(n) * 3 + _GEMM_BUCKET(k);
+}
+
+#if __has_include("gemm_tiles.h")
+#include "gemm_tiles.h"
+#endif
+
+/*!
+ * \brief The tuned table is used only if it is tuned for the scratchpad in spec.h, and for
+ *        the recurrence of the tiles.
+ */
+#if defined(GEMM_TILES_TUNED) && GEMM_TILES_SCRATCH_SIZE == SCRATCH_SIZE && \
+    GEMM_TILES_SCRATCH_BANKS == NUM_SCRATCH_BANKS && GEMM_TILES_VEC == GEMM_VEC && \
+    defined(GEMM_TILES_RECUR_LEN) && GEMM_TILES_RECUR_LEN == GEMM_RECUR_LEN
+#define _GEMM_USE_TUNED 1
+#else
+#define _GEMM_USE_TUNED 0
+#endif
+
+/*! \brief The bytes of the scratchpad used by the tile, i.e. two buffers of B. */
+inline uint64_t GEMM_FOOTPRINT(const GemmTile *t, int dtype) {
+  return 2 * t->tk * t->tn * dtype;
+}
+
+/*! \brief The elements of C the tile recurs at a time. */
+inline uint64_t GEMM_RECUR_ELEMS(const GemmTile *t) {
+  return std::min(t->tn, (uint64_t) GEMM_RECUR_LEN);
+}
+
+/*!
+ * \brief If the tile runs on the hardware, i.e. its two buffers of B fit in the scratchpad,
+ *        and its recurrence fits in the buffering of the ports.
+ */
+inline bool GEMM_FITS(const GemmTile *t, int dtype) {
+  return GEMM_FOOTPRINT(t, dtype) <= SCRATCH_SIZE && GEMM_RECUR_ELEMS(t) <= CGRA_FIFO_LEN;
+}
+
+/*!
+ * \brief The default tile: square tiles of B as large as two of them fit in the scratchpad,
+ *        up to 128 x 128, and 64 rows of A, halved further if the recurrence does not fit.
+ */
+inline GemmTile GEMM_DEFAULT_TILE(int dtype) {
+  GemmTile res{64, 128, 128};
+  while (!GEMM_FITS(&res, dtype) && res.tn > GEMM_VEC) {
+    res.tn /= 2;
+    res.tk /= 2;
+  }
+  return res;
+}
+
+/*! \brief The tile of the given shape. */
+inline GemmTile GEMM_TILE(uint64_t m, uint64_t n, uint64_t k, int dtype) {
+#if _GEMM_USE_TUNED
+  if (dtype == GEMM_TILES_DTYPE) {
+    return GEMM_TILES[GEMM_BUCKET(m, n, k)];
+  }
+#else
+  (void) m;
+  (void) n;
+  (void) k;
+#endif
+  return GEMM_DEFAULT_TILE(dtype);
+}
+
+/*!
+ * \brief Load the tile of B at the row k0 and the column j0 to the scratchpad buffer,
+ *        whose rows are tn elements apart.
+ */
+DSA_INLINE void _GEMM_LOAD_B(const GemmAttr *ga, const GemmTile *t, const GemmPorts *p,
+                             uint64_t k0, uint64_t j0, uint64_t bk, uint64_t bn, uint64_t buf) {
+  int d = ga->dtype;
+  INSTANTIATE_2D_STREAM(ga->b.value + (k0 * ga->ldb + j0) * d, (uint64_t) 1, bn, ga->ldb,
+                        (uint64_t) 0, bk, p->in_pass, DP_NoPadding, DSA_Access, DMO_Read,
+                        DMT_DMA, d, 0);
+  INSTANTIATE_2D_STREAM(buf, (uint64_t) 1, bn, t->tn, (uint64_t) 0, bk, p->out_pass,
+                        DP_NoPadding, DSA_Access, DMO_Write, DMT_SPAD, d, 0);
+}
+
+/*!
+ * \brief C[i0:i0+bm, j0:j0+bn] += A[i0:i0+bm, k0:k0+bk] * B[k0:k0+bk, j0:j0+bn], where the
+ *        tile of B is in the scratchpad buffer. Each row of the C tile is done in slices of
+ *        GEMM_RECUR_LEN elements, and the reduction is the inner loop of a slice, so only
+ *        the slice is recurred bk-1 times.
+ */
+DSA_INLINE void _GEMM_TILE(const GemmAttr *ga, const GemmTile *t, const GemmPorts *p,
+                           uint64_t i0, uint64_t j0, uint64_t k0,
+                           uint64_t bm, uint64_t bn, uint64_t bk, uint64_t buf) {
+  int d = ga->dtype;
+  for (uint64_t i = i0; i < i0 + bm; ++i) {
+    for (uint64_t jj = 0; jj < bn; jj += GEMM_RECUR_LEN) {
+      uint64_t bw = std::min((uint64_t) GEMM_RECUR_LEN, bn - jj);
+      REG c = ga->c.value + (i * ga->ldc + j0 + jj) * d;
+      INSTANTIATE_1D_STREAM(c, (uint64_t) 1, bw, p->in_c, DP_NoPadding, DSA_Access, DMO_Read,
+                            DMT_DMA, d, 0);
+      if (bk > 1) {
+        SS_RECURRENCE(p->out_c, p->in_c, bw * (bk - 1), d);
+      }
+      INSTANTIATE_1D_STREAM(c, (uint64_t) 1, bw, p->out_c, DP_NoPadding, DSA_Access, DMO_Write,
+                            DMT_DMA, d, 0);
+      // The row i of the A tile, each element for bw/GEMM_VEC vectors.
+      SS_REPEAT_PORT(p->in_a, bw / GEMM_VEC);
+      INSTANTIATE_1D_STREAM(ga->a.value + (i * ga->lda + k0) * d, (uint64_t) 1, bk, p->in_a,
+                            DP_NoPadding, DSA_Access, DMO_Read, DMT_DMA, d, 0);
+      // The slice of each row kk of the B tile.
+      INSTANTIATE_2D_STREAM(buf + jj * d, (uint64_t) 1, bw, t->tn, (uint64_t) 0, bk, p->in_b,
+                            DP_NoPadding, DSA_Access, DMO_Read, DMT_SPAD, d, 0);
+    }
+  }
+}
+
+/*!
+ * \brief C += A*B with the given tile. The loops are j0, k0, and i0 from the outermost, so
+ *        each tile of B is loaded once, while the next one is loaded to the other buffer.
+ */
+DSA_INLINE void SS_GEMM_TILED(const GemmAttr *ga, const GemmTile *t, const GemmPorts *p) {
+  uint64_t buf_bytes = t->tk * t->tn * ga->dtype;
+  uint64_t iter = 0;
+  // The barrier of a tile of B, after which its load, and the reads and the writes of C
+  // of the previous one are done.
+  REG barrier((uint64_t) ((1 << DBF_DMAStreams) | (1 << DBF_SPadStreams)));
+  _GEMM_LOAD_B(ga, t, p, 0, 0, std::min(t->tk, ga->k), std::min(t->tn, ga->n), ga->spad.value);
+  for (uint64_t j0 = 0; j0 < ga->n; j0 += t->tn) {
+    uint64_t bn = std::min(t->tn, ga->n - j0);
+    for (uint64_t k0 = 0; k0 < ga->k; k0 += t->tk, ++iter) {
+      uint64_t bk = std::min(t->tk, ga->k - k0);
+      uint64_t buf = ga->spad.value + (iter & 1) * buf_bytes;
+      SS_WAIT(barrier);
+      uint64_t nk0 = k0 + t->tk < ga->k ? k0 + t->tk : 0;
+      uint64_t nj0 = nk0 ? j0 : j0 + t->tn;
+      if (nj0 < ga->n) {
+        _GEMM_LOAD_B(ga, t, p, nk0, nj0, std::min(t->tk, ga->k - nk0),
+                     std::min(t->tn, ga->n - nj0), ga->spad.value + (~iter & 1) * buf_bytes);
+      }
+      for (uint64_t i0 = 0; i0 < ga->m; i0 += t->tm) {
+        _GEMM_TILE(ga, t, p, i0, j0, k0, std::min(t->tm, ga->m - i0), bn, bk, buf);
+      }
+    }
+  }
+}
+
+/*!
+ * \brief C += A*B with the tile of its shape.
+ */
+DSA_INLINE void SS_GEMM(const GemmAttr *ga, const GemmPorts *p) {
+  GemmTile t = GEMM_TILE(ga->m, ga->n, ga->k, ga->dtype);
+  SS_GEMM_TILED(ga, &t, p);
+}
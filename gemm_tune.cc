@@ -0,0 +1,182 @@
+/*!
+ * \file gemm_tune.cc
+ * \author PolyArch Research Lab
+ * \brief The tile autotuner of gemm.h. It enumerates the tiles fitting the scratchpad of
+ *        spec.h, runs a representative shape of each bucket with each tile, and writes the
+ *        fastest tiles to gemm_tiles.h. With DSA_SOFT_MODEL, the tiles run on the software
+ *        model; otherwise, they run on the hardware and are timed by rdcycle.
+ *        Usage: gemm_tune [gemm_tiles.h]
+ * \copyright Copyright (c) 2020
+ */
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "gemm.h"
+
+/*!
+ * \brief The data type tuned for.
+ */
+#ifndef GEMM_TUNE_DTYPE
+#define GEMM_TUNE_DTYPE 8
+#endif
+
+/*!
+ * \brief The largest tile size enumerated of each dimension.
+ */
+#ifndef GEMM_TUNE_MAX_TILE
+#define GEMM_TUNE_MAX_TILE 512
+#endif
+
+/*!
+ * \brief The representative size of each bucket of a dimension.
+ */
+const uint64_t BUCKET_SIZE[] = {32, 128, 512};
+
+/*!
+ * \brief The ports, which only matter to the hardware, where the configuration of gemm.h
+ *        should be loaded by GEMM_TUNE_CONFIG.
+ */
+static constexpr GemmPorts PORTS{0, 1, 2, 0, 3, 1};
+
+/*!
+ * \brief The cycles within this ratio are a tie, broken by the fewer instructions issued,
+ *        which leave the control host more cycles of its own.
+ */
+#ifndef GEMM_TUNE_TIE
+#define GEMM_TUNE_TIE 0.01
+#endif
+
+/*!
+ * \brief The result of running a tile. The instructions are only known to the model.
+ */
+struct TuneResult {
+  double cycles;
+  uint64_t insts;
+};
+
+/*! \brief Run the shape with the tile. */
+TuneResult Run(GemmAttr *ga, const GemmTile *t) {
+#ifdef DSA_SOFT_MODEL
+  DSA_MODEL_RESET();
+  SS_GEMM_TILED(ga, t, &PORTS);
+  SS_WAIT_ALL();
+  DSAModelStats stats = DSA_MODEL_STATS();
+  if (stats.spad_high > SCRATCH_SIZE) {
+    return {-1, 0};
+  }
+  return {stats.cycles, stats.insts};
+#else
+  uint64_t begin, end;
+  __asm__ __volatile__("rdcycle %0" : "=r"(begin));
+  SS_GEMM_TILED(ga, t, &PORTS);
+  SS_WAIT_ALL();
+  __asm__ __volatile__("rdcycle %0" : "=r"(end));
+  return {(double) (end - begin), 0};
+#endif
+}
+
+/*! \brief If a is better than b. */
+bool Better(const TuneResult &a, const TuneResult &b) {
+  if (a.cycles < 0) {
+    return false;
+  }
+  if (b.cycles < 0 || a.cycles < b.cycles * (1 - GEMM_TUNE_TIE)) {
+    return true;
+  }
+  return a.cycles <= b.cycles * (1 + GEMM_TUNE_TIE) && a.insts < b.insts;
+}
+
+/*!
+ * \brief The tiles of powers of two, which fit the scratchpad and the buffering of the ports,
+ *        and whose rows of B are whole lines of the scratchpad, so that the rows start at the
+ *        same bank.
+ */
+std::vector<GemmTile> Candidates(int dtype) {
+  std::vector<GemmTile> res;
+  for (uint64_t tm = 8; tm <= GEMM_TUNE_MAX_TILE; tm *= 2) {
+    for (uint64_t tn = GEMM_VEC; tn <= GEMM_TUNE_MAX_TILE; tn *= 2) {
+      for (uint64_t tk = 8; tk <= GEMM_TUNE_MAX_TILE; tk *= 2) {
+        GemmTile t{tm, tn, tk};
+        if (GEMM_FITS(&t, dtype) && tn * dtype % SCR_WIDTH == 0) {
+          res.push_back(t);
+        }
+      }
+    }
+  }
+  return res;
+}
+
+int main(int argc, char **argv) {
+  int d = GEMM_TUNE_DTYPE;
+  uint64_t max_size = BUCKET_SIZE[2];
+  std::vector<char> a(max_size * max_size * d), b(a.size()), c(a.size());
+#if !defined(DSA_SOFT_MODEL) && defined(GEMM_TUNE_CONFIG)
+  SS_CONFIG(GEMM_TUNE_CONFIG, GEMM_TUNE_CONFIG_SIZE);
+#endif
+  std::vector<GemmTile> cands = Candidates(d);
+  if (cands.empty()) {
+    fprintf(stderr, "No tile fits the scratchpad of %d bytes.\n", (int) SCRATCH_SIZE);
+    return 1;
+  }
+  GemmTile best[GEMM_BUCKETS];
+  for (int bm = 0; bm < 3; ++bm) {
+    for (int bn = 0; bn < 3; ++bn) {
+      for (int bk = 0; bk < 3; ++bk) {
+        uint64_t m = BUCKET_SIZE[bm], n = BUCKET_SIZE[bn], k = BUCKET_SIZE[bk];
+        GemmAttr ga;
+        ga.a = a.data();
+        ga.b = b.data();
+        ga.c = c.data();
+        ga.m = m;
+        ga.n = n;
+        ga.k = k;
+        ga.lda = k;
+        ga.ldb = ga.ldc = n;
+        ga.dtype = d;
+        TuneResult best_res{-1, 0};
+        int idx = GEMM_BUCKET(m, n, k);
+        best[idx] = GEMM_DEFAULT_TILE(d);
+        for (auto &t : cands) {
+          // The tiles twice larger than the shape are the same as the halved ones.
+          if (t.tm >= 2 * m || t.tn >= 2 * n || t.tk >= 2 * k) {
+            continue;
+          }
+          TuneResult res = Run(&ga, &t);
+          if (Better(res, best_res)) {
+            best_res = res;
+            best[idx] = t;
+          }
+        }
+        fprintf(stderr, "%" PRIu64 " x %" PRIu64 " x %" PRIu64 ": "
+                "%" PRIu64 " x %" PRIu64 " x %" PRIu64 ", %.0f cycles, %" PRIu64 " instructions\n",
+                m, n, k, best[idx].tm, best[idx].tn, best[idx].tk, best_res.cycles, best_res.insts);
+      }
+    }
+  }
+  FILE *out = argc > 1 ? fopen(argv[1], "w") : stdout;
+  if (!out) {
+    perror(argv[1]);
+    return 1;
+  }
+  fprintf(out, "// Generated by gemm_tune. Do not edit. Run `make tune-gemm` instead.\n\n");
+  fprintf(out, "#pragma once\n\n");
+  fprintf(out, "#define GEMM_TILES_TUNED 1\n");
+  fprintf(out, "#define GEMM_TILES_SCRATCH_SIZE %" PRIu64 "\n", (uint64_t) SCRATCH_SIZE);
+  fprintf(out, "#define GEMM_TILES_SCRATCH_BANKS %" PRIu64 "\n", (uint64_t) NUM_SCRATCH_BANKS);
+  fprintf(out, "#define GEMM_TILES_VEC %d\n", GEMM_VEC);
+  fprintf(out, "#define GEMM_TILES_RECUR_LEN %d\n", (int) GEMM_RECUR_LEN);
+  fprintf(out, "#define GEMM_TILES_DTYPE %d\n\n", d);
+  fprintf(out, "const GemmTile GEMM_TILES[GEMM_BUCKETS] = {\n");
+  for (int i = 0; i < GEMM_BUCKETS; ++i) {
+    fprintf(out, "  {%" PRIu64 ", %" PRIu64 ", %" PRIu64 "},\n", best[i].tm, best[i].tn, best[i].tk);
+  }
+  fprintf(out, "};\n");
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,270 @@
+/*!
+ * \file histogram.h
+ * \author PolyArch Research Lab
+ * \brief Conflict-aware histogram and scatter-reduce, a[key[i]] op= val[i].
+ *        The key distribution is sampled to find the hot bins, which are privatized into a
+ *        copy in the local scratchpad of each lane and merged into the shared bins at the end,
+ *        so that the atomic updates of a skewed input do not serialize on a few addresses.
+ * \note The updates on the fabric are configured by the legacy SS_CONFIG_ATOMIC_SCR_OP and
+ *       SS_ATOMIC_SCR_OP, i.e. ss_cfg_atom_op and ss_atom_op, which are neither in isa.ext nor
+ *       in the software model, so the plan never chooses them under DSA_SOFT_MODEL.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The max number of keys sampled to plan a histogram.
+ */
+#ifndef DSA_HIST_SAMPLES
+#define DSA_HIST_SAMPLES 4096
+#endif
+
+/*!
+ * \brief The max number of privatized bins.
+ */
+#ifndef DSA_HIST_MAX_HOT
+#define DSA_HIST_MAX_HOT 64
+#endif
+
+/*!
+ * \brief A bin is hot if it takes at least 1/DSA_HIST_HOT_DIVISOR of the sampled keys.
+ *        By default, a bin is hot if it alone gets 4x the fair share of a bank.
+ */
+#ifndef DSA_HIST_HOT_DIVISOR
+#define DSA_HIST_HOT_DIVISOR (NUM_SCRATCH_BANKS * 4)
+#endif
+
+/*!
+ * \brief The updates are done on the fabric, if the hottest address is expected to have at
+ *        least this many requests at the same time in the atomic request queue.
+ */
+#ifndef DSA_HIST_FABRIC_CONFLICTS
+#define DSA_HIST_FABRIC_CONFLICTS 2
+#endif
+
+/*!
+ * \brief The ports of the histogram. The in_* and out_* ports belong to the spatial
+ *        configuration, and the ind_* ports feed the indirect stream engine directly.
+ *        Near-memory updates: out_val passes in_val through, and the storage unit does the op.
+ *        On-fabric updates: the configuration does the op on the stored value and in_val,
+ *        and writes the result to out_val. Refer SS_CONFIG_ATOMIC_SCR_OP.
+ *        In both cases, out_pass passes in_pass through, to initialize and merge the copies.
+ */
+struct HistPorts {
+  int in_val, out_val;
+  int in_pass, out_pass;
+  /*!
+   * \brief The keys, and the addresses of the updates gathered from the route table.
+   */
+  int ind_key{P_IND_1}, ind_addr{P_IND_2};
+};
+
+/*!
+ * \brief The plan of a histogram, made by DSA_HIST_PLAN and routed by DSA_HIST_ROUTE.
+ */
+struct HistPlan {
+  uint64_t bins;
+  /*!
+   * \brief The data type of the bins in bytes.
+   */
+  int dtype{8};
+  /*!
+   * \brief The privatized bins, in the descending order of the sampled frequency.
+   */
+  int n_hot;
+  uint64_t hot[DSA_HIST_MAX_HOT];
+  /*!
+   * \brief The sampled share of the hottest bin, and the share of all the hot bins.
+   */
+  double top, hot_share;
+  /*!
+   * \brief If the updates are done on the fabric, i.e. is_update_port of SS_CONFIG_ATOMIC_SCR_OP.
+   */
+  bool on_fabric;
+  /*!
+   * \brief The shared bins, and the copy of the hot bins in the local scratchpad of each lane.
+   */
+  uint64_t hist, priv;
+  /*!
+   * \brief The word addresses of the shared hot bins, read by the merge.
+   */
+  uint32_t merge[DSA_HIST_MAX_HOT];
+};
+
+/*! \brief Load the i-th key of the given data type. */
+inline uint64_t _HIST_KEY(const void *keys, int key_dtype, uint64_t i) {
+  switch (key_dtype) {
+    case 1: return ((const uint8_t*) keys)[i];
+    case 2: return ((const uint16_t*) keys)[i];
+    case 4: return ((const uint32_t*) keys)[i];
+    default: return ((const uint64_t*) keys)[i];
+  }
+}
+
+/*!
+ * \brief Sample the keys to find the hot bins, and choose where the updates are done.
+ * \param keys The keys in the main memory, of key_dtype bytes each.
+ * \param n The number of keys.
+ * \param bins The number of bins. Keys out of range are ignored by the sampling, but they are
+ *             not allowed by DSA_HIST_RUN.
+ * \param dtype The data type of the bins in bytes.
+ */
+inline void DSA_HIST_PLAN(HistPlan *plan, const void *keys, int key_dtype, uint64_t n,
+                          uint64_t bins, int dtype) {
+  plan->bins = bins;
+  plan->dtype = dtype;
+  plan->n_hot = 0;
+  plan->top = plan->hot_share = 0;
+  std::vector<uint64_t> sample;
+  sample.reserve(n < DSA_HIST_SAMPLES ? n : DSA_HIST_SAMPLES);
+  uint64_t step = n > DSA_HIST_SAMPLES ? n / DSA_HIST_SAMPLES : 1;
+  for (uint64_t i = 0; i < n && sample.size() < DSA_HIST_SAMPLES; i += step) {
+    uint64_t key = _HIST_KEY(keys, key_dtype, i);
+    if (key < bins) {
+      sample.push_back(key);
+    }
+  }
+  std::sort(sample.begin(), sample.end());
+  int m = sample.size();
+  // The runs of the sorted sample above the threshold, as (count, key) pairs.
+  // There are at most DSA_HIST_HOT_DIVISOR of them.
+  std::pair<uint64_t, uint64_t> runs[DSA_HIST_HOT_DIVISOR];
+  int n_runs = 0;
+  for (int i = 0, j; i < m; i = j) {
+    for (j = i; j < m && sample[j] == sample[i]; ++j) {
+    }
+    if ((uint64_t) (j - i) * DSA_HIST_HOT_DIVISOR >= (uint64_t) m && j - i > 1) {
+      runs[n_runs++] = {j - i, sample[i]};
+    }
+  }
+  std::sort(runs, runs + n_runs, std::greater<std::pair<uint64_t, uint64_t>>());
+  plan->n_hot = n_runs < DSA_HIST_MAX_HOT ? n_runs : DSA_HIST_MAX_HOT;
+  for (int i = 0; i < plan->n_hot; ++i) {
+    plan->hot[i] = runs[i].second;
+    plan->hot_share += (double) runs[i].first / m;
+  }
+  plan->top = plan->n_hot ? (double) runs[0].first / m : 0;
+#ifdef DSA_SOFT_MODEL
+  plan->on_fabric = false;
+#else
+  plan->on_fabric = plan->top * MAX_ATOM_REQ_QUEUE_SIZE >= DSA_HIST_FABRIC_CONFLICTS;
+#endif
+}
+
+/*!
+ * \brief Fill the route table, which maps each key to the word address of its update:
+ *        a hot key to its slot of the local copy, and the others to the shared bins.
+ *        The table is shared by all the lanes, because the local copy is at the same
+ *        address of the scratchpad of each lane.
+ * \param route The table of bins 32-bit entries in the main memory.
+ * \param hist The shared bins in the scratchpad. It should be in the shared scratchpad
+ *             if more than one lane updates it.
+ * \param priv The local copy of the hot bins in the scratchpad of each lane.
+ */
+inline void DSA_HIST_ROUTE(HistPlan *plan, uint32_t *route, uint64_t hist, uint64_t priv) {
+  plan->hist = hist;
+  plan->priv = priv;
+  for (uint64_t i = 0; i < plan->bins; ++i) {
+    route[i] = hist / plan->dtype + i;
+  }
+  for (int i = 0; i < plan->n_hot; ++i) {
+    route[plan->hot[i]] = priv / plan->dtype + i;
+    plan->merge[i] = hist / plan->dtype + plan->hot[i];
+  }
+}
+
+/*!
+ * \brief Instantiate the on-fabric update stream of the given data type of the bins.
+ *        It is the legacy encoding, which is not available on the software model.
+ */
+DSA_INLINE void _HIST_FABRIC(int addr_port, int val_port, int dtype, uint64_t n) {
+#ifdef DSA_SOFT_MODEL
+  (void) addr_port;
+  (void) val_port;
+  (void) dtype;
+  (void) n;
+#else
+  switch (dtype) {
+    case 1: SS_CONFIG_ATOMIC_SCR_OP(T32, T08, T08, 1, n, 1); break;
+    case 2: SS_CONFIG_ATOMIC_SCR_OP(T32, T16, T16, 1, n, 1); break;
+    case 4: SS_CONFIG_ATOMIC_SCR_OP(T32, T32, T32, 1, n, 1); break;
+    default: SS_CONFIG_ATOMIC_SCR_OP(T32, T64, T64, 1, n, 1); break;
+  }
+  SS_ATOMIC_SCR_OP(addr_port, val_port, 0, n, 0);
+#endif
+}
+
+/*! \brief If all the keys are less than the bins, i.e. the entries of the route table. */
+inline bool _HIST_IN_RANGE(const HistPlan *plan, REG keys, int key_dtype, uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+    if (_HIST_KEY((const void*) keys.value, key_dtype, i) >= plan->bins) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+ * \brief Run the histogram, a[key[i]] op= val[i], across the given lanes. Each lane updates
+ *        an even share of the keys. The local copies are initialized to the identity before,
+ *        and merged into the shared bins after the updates.
+ *        The commands are left in flight; wait for them by SS_WAIT_ALL.
+ * \param route The route table filled by DSA_HIST_ROUTE. The keys index it on the fabric, so
+ *              they should be less than the bins, which is asserted.
+ * \param vals The operands in the main memory, or 0 to count the keys (val[i] = 1).
+ * \param op One of DMO_Add, DMO_Min, and DMO_Max.
+ * \param identity The identity element of op, which the local copies start with.
+ * \param lanes The number of lanes. Lane i is bit i of SS_CONTEXT.
+ */
+DSA_INLINE void DSA_HIST_RUN(const HistPlan *plan, const uint32_t *route, REG keys, int key_dtype,
+                             REG vals, uint64_t n, MemoryOperation op, uint64_t identity,
+                             const HistPorts *p, int lanes) {
+  assert(_HIST_IN_RANGE(plan, keys, key_dtype, n));
+  int dtype = plan->dtype;
+  uint64_t all = lanes >= 64 ? ~0ull : (1ull << lanes) - 1;
+  SS_CONTEXT(all);
+  if (plan->n_hot) {
+    SS_CONST(p->in_pass, identity, plan->n_hot, dtype);
+    SS_1D_WRITE(p->out_pass, plan->priv, plan->n_hot * dtype, DMT_SPAD, dtype);
+    REG written((uint64_t) (1 << DBF_SPadStreams));
+    SS_WAIT(written);
+  }
+  for (int lane = 0; lane < lanes; ++lane) {
+    uint64_t lo = n * lane / lanes, len = n * (lane + 1) / lanes - lo;
+    if (!len) {
+      continue;
+    }
+    SS_CONTEXT(1ull << lane);
+    SS_1D_READ(keys.value + lo * key_dtype, len * key_dtype, p->ind_key,
+               DP_NoPadding, DMT_DMA, key_dtype);
+    SS_INDIRECT_READ(p->ind_addr, 4, p->ind_key, key_dtype, (uint64_t) route, 1, len, DMT_DMA, false, false);
+    if (vals.value) {
+      SS_1D_READ(vals.value + lo * dtype, len * dtype, p->in_val, DP_NoPadding, DMT_DMA, dtype);
+    } else {
+      SS_CONST(p->in_val, 1, len, dtype);
+    }
+    if (plan->on_fabric) {
+      _HIST_FABRIC(p->ind_addr, p->out_val, dtype, len);
+    } else {
+      SS_INDIRECT_ATOMIC(p->out_val, dtype, p->ind_addr, 4, (uint64_t) 0, 1, len, DMT_SPAD, op);
+    }
+  }
+  SS_CONTEXT(all);
+  if (plan->n_hot) {
+    REG updated((uint64_t) (1 << DBF_AtomicStreams));
+    SS_WAIT(updated);
+    SS_1D_READ(plan->priv, plan->n_hot * dtype, p->in_pass, DP_NoPadding, DMT_SPAD, dtype);
+    SS_1D_READ((uint64_t) plan->merge, plan->n_hot * 4, p->ind_addr, DP_NoPadding, DMT_DMA, 4);
+    SS_INDIRECT_ATOMIC(p->out_pass, dtype, p->ind_addr, 4, (uint64_t) 0, 1, plan->n_hot,
+                       DMT_SPAD, op);
+  }
+}
@@ -0,0 +1,198 @@
+/*!
+ * \file idx_codec.h
+ * \author PolyArch Research Lab
+ * \brief The host encoder of the compressed index streams decoded by the indirect stream
+ *        engine, and the gathers reading them. Refer rf.h:IndexFormat for the formats.
+ *        All the encoded streams are sequences of 8-byte words:
+ *        DIF_DeltaPacked: each block of up to 2^log_block indices starts with a header word,
+ *                         the base index in bits [0, 58) and the width w in bits [58, 64),
+ *                         followed by the zigzag deltas to the previous index packed in w bits
+ *                         each from the LSB, padded to a word at the end of the block.
+ *        DIF_RunLength: each run of consecutive indices start, start+1, ..., start+len-1
+ *                       is a word, start in bits [0, 40) and len-1 in bits [40, 64).
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The default log2 of the block size of DIF_DeltaPacked.
+ */
+#ifndef DSA_IDX_LOG_BLOCK
+#define DSA_IDX_LOG_BLOCK 6
+#endif
+
+/*!
+ * \brief An encoded index stream.
+ */
+struct IndexCode {
+  IndexFormat format;
+  int log_block{DSA_IDX_LOG_BLOCK};
+  /*!
+   * \brief The number of decoded indices.
+   */
+  uint64_t n;
+  /*!
+   * \brief The encoded words.
+   */
+  uint64_t *data;
+  uint64_t words;
+};
+
+/*! \brief Load the i-th index of the given data type. */
+inline uint64_t _IDX_LOAD(const void *idx, int itype, uint64_t i) {
+  switch (itype) {
+    case 1: return ((const uint8_t*) idx)[i];
+    case 2: return ((const uint16_t*) idx)[i];
+    case 4: return ((const uint32_t*) idx)[i];
+    default: return ((const uint64_t*) idx)[i];
+  }
+}
+
+/*! \brief The zigzag code of a signed delta, so that small deltas of both signs are short. */
+inline uint64_t _IDX_ZIGZAG(uint64_t cur, uint64_t prev) {
+  int64_t d = (int64_t) (cur - prev);
+  return ((uint64_t) d << 1) ^ (uint64_t) (d >> 63);
+}
+
+/*! \brief The number of words to encode n indices, in the worst case of the given format. */
+inline uint64_t DSA_IDX_BOUND(IndexFormat format, uint64_t n, int log_block = DSA_IDX_LOG_BLOCK) {
+  if (format == DIF_DeltaPacked) {
+    uint64_t blocks = (n + (1ull << log_block) - 1) >> log_block;
+    return blocks + n;
+  }
+  return n;
+}
+
+/*!
+ * \brief Encode n indices of itype bytes each. The indices should be less than 2^40.
+ * \param out The buffer of at least DSA_IDX_BOUND(format, n) words.
+ * \return The code, whose data is out.
+ */
+inline IndexCode DSA_IDX_ENCODE(IndexFormat format, const void *idx, int itype, uint64_t n,
+                                uint64_t *out, int log_block = DSA_IDX_LOG_BLOCK) {
+  IndexCode res;
+  res.format = format;
+  res.log_block = log_block;
+  res.n = n;
+  res.data = out;
+  uint64_t w = 0;
+  if (format == DIF_RunLength) {
+    for (uint64_t i = 0, j; i < n; i = j) {
+      uint64_t start = _IDX_LOAD(idx, itype, i);
+      for (j = i + 1; j < n && j - i < (1ull << 24) && _IDX_LOAD(idx, itype, j) == start + (j - i); ++j) {
+      }
+      out[w++] = start | ((j - i - 1) << 40);
+    }
+  } else if (format == DIF_DeltaPacked) {
+    uint64_t block = 1ull << log_block;
+    for (uint64_t i = 0; i < n; i += block) {
+      uint64_t cnt = n - i < block ? n - i : block;
+      uint64_t width = 0;
+      for (uint64_t j = 1; j < cnt; ++j) {
+        uint64_t z = _IDX_ZIGZAG(_IDX_LOAD(idx, itype, i + j), _IDX_LOAD(idx, itype, i + j - 1));
+        uint64_t bw = z ? 64 - __builtin_clzll(z) : 0;
+        width = bw > width ? bw : width;
+      }
+      out[w++] = _IDX_LOAD(idx, itype, i) | (width << 58);
+      uint64_t bits = 0;
+      for (uint64_t j = 1; j < cnt && width; ++j) {
+        uint64_t z = _IDX_ZIGZAG(_IDX_LOAD(idx, itype, i + j), _IDX_LOAD(idx, itype, i + j - 1));
+        if (bits % 64 == 0) {
+          out[w + bits / 64] = 0;
+        }
+        out[w + bits / 64] |= z << (bits % 64);
+        if (bits % 64 + width > 64) {
+          out[w + bits / 64 + 1] = z >> (64 - bits % 64);
+        }
+        bits += width;
+      }
+      w += (bits + 63) / 64;
+    }
+  } else {
+    for (uint64_t i = 0; i < n; ++i) {
+      out[w++] = _IDX_LOAD(idx, itype, i);
+    }
+  }
+  res.words = w;
+  return res;
+}
+
+/*!
+ * \brief Decode the code to n 8-byte indices on the host, the reference of the stream engine.
+ */
+inline void DSA_IDX_DECODE(const IndexCode *code, uint64_t *idx) {
+  const uint64_t *in = code->data;
+  uint64_t n = 0;
+  if (code->format == DIF_RunLength) {
+    for (uint64_t w = 0; n < code->n; ++w) {
+      for (uint64_t j = 0; j <= in[w] >> 40; ++j) {
+        idx[n++] = (in[w] & ((1ull << 40) - 1)) + j;
+      }
+    }
+  } else if (code->format == DIF_DeltaPacked) {
+    uint64_t block = 1ull << code->log_block;
+    for (uint64_t w = 0; n < code->n; ) {
+      uint64_t cnt = code->n - n < block ? code->n - n : block;
+      uint64_t width = in[w] >> 58;
+      idx[n++] = in[w++] & ((1ull << 58) - 1);
+      uint64_t bits = 0;
+      for (uint64_t j = 1; j < cnt; ++j) {
+        uint64_t z = 0;
+        if (width) {
+          z = in[w + bits / 64] >> (bits % 64);
+          if (bits % 64 + width > 64) {
+            z |= in[w + bits / 64 + 1] << (64 - bits % 64);
+          }
+          z &= width == 64 ? ~0ull : (1ull << width) - 1;
+        }
+        int64_t d = (int64_t) (z >> 1) ^ -(int64_t) (z & 1);
+        idx[n] = idx[n - 1] + d;
+        ++n;
+        bits += width;
+      }
+      w += (bits + 63) / 64;
+    }
+  } else {
+    for (; n < code->n; ++n) {
+      idx[n] = in[n];
+    }
+  }
+}
+
+/*!
+ * \brief Encode the indices in the compressed format with the fewest words.
+ *        If words * 8 is not less than n * itype, the plain indices are cheaper to gather.
+ * \param out The buffer of at least DSA_IDX_BOUND(DIF_DeltaPacked, n) words.
+ */
+inline IndexCode DSA_IDX_ENCODE_BEST(const void *idx, int itype, uint64_t n, uint64_t *out) {
+  // The code encoded last is the one left in out, so only the winning RLE is encoded again.
+  IndexCode rle = DSA_IDX_ENCODE(DIF_RunLength, idx, itype, n, out);
+  IndexCode delta = DSA_IDX_ENCODE(DIF_DeltaPacked, idx, itype, n, out);
+  return rle.words <= delta.words ? DSA_IDX_ENCODE(DIF_RunLength, idx, itype, n, out) : delta;
+}
+
+/*!
+ * \brief Gather a[b[i]] to a port, where b is an encoded index stream in the main memory.
+ * \param idx_port The port the encoded words go through to the indirect stream engine.
+ */
+DSA_INLINE void SS_INDIRECT_READ_PACKED(int in_port, int dtype, int idx_port, const IndexCode *code,
+                                        REG start, REG stride, int memory,
+                                        bool penetrate = false, bool associate = false) {
+  SS_1D_READ(code->data, code->words * 8, idx_port, DP_NoPadding, DMT_DMA, 8);
+  INSTANTIATE_1D_INDIRECT_PACKED(in_port, dtype, idx_port, code->format, code->log_block,
+                                 start, stride, code->n, memory, DMO_Read, penetrate, associate);
+}
+
+/*!
+ * \brief The atomic update a[b[i]] op= c[i], where b is an encoded index stream.
+ */
+DSA_INLINE void SS_INDIRECT_ATOMIC_PACKED(int operand_port, int otype, int idx_port,
+                                          const IndexCode *code, REG start, REG stride,
+                                          int memory, MemoryOperation operation) {
+  SS_1D_READ(code->data, code->words * 8, idx_port, DP_NoPadding, DMT_DMA, 8);
+  INSTANTIATE_1D_INDIRECT_PACKED(operand_port, otype, idx_port, code->format, code->log_block,
+                                 start, stride, code->n, memory, operation, false, false);
+}
@@ -125,10 +125,18 @@ inline void CONFIG_1D_STREAM(REG start, REG stride1d, REG length, int dtype, int
   CONFIG_PARAM(DSARF::CSR, DTYPE_MASK(dtype, ctype, 0), 1, DSARF::I1D, stride1d, 0);
 }
 
-/*! \brief Concatenate the given values in a bitmask. */
+/*!
+ * \brief Concatenate the given values in a bitmask.
+ * \param termination Refer rf.h:StreamTermination for more details.
+ * \param prefetch If the stream only touches the lines of the memory into the cache, without
+ *                 delivering the data to the port.
+ */
 inline uint64_t LINEAR_STREAM_MASK(int port, int padding, int action, int dimension,
-                                   int operation, int memory) {
-  uint64_t res = dimension & 3;
+                                   int operation, int memory, int termination = DST_Length,
+                                   bool prefetch = false) {
+  uint64_t res = prefetch;
+  res = (res << 2) | (termination & 3);
+  res = (res << 2) | (dimension & 3);
   res = (res << 1) | (action & 1);
   res = (res << 3) | (padding & 7);
   res = (res << 1) | (memory & 1);
@@ -145,6 +153,10 @@ inline uint64_t LINEAR_STREAM_MASK(int port, int padding, int action, int dimens
  *                 x1x: if use offset address from a port, ow the stride2d * outer;
  *                 1xx: if use length from a port, ow the l1d register.
  * \param lin_mode 0: 1d indirect stream; 2: 2d indirect stream
+ * \param join The mode of a join stream. Refer rf.h:JoinMode for more details.
+ * \param format The format of the index stream. Refer rf.h:IndexFormat for more details.
+ * \param prefetch If the stream only touches the lines of the memory into the cache, without
+ *                 delivering the data to the port.
  */
 inline uint64_t INDIRECT_STREAM_MASK(int port,
                                      int memory,
@@ -152,8 +164,14 @@ inline uint64_t INDIRECT_STREAM_MASK(int port,
                                      int dim,
                                      MemoryOperation operation,
                                      bool penetrate,
-                                     bool associate) {
-  uint64_t value = associate;
+                                     bool associate,
+                                     int join = DJM_None,
+                                     int format = DIF_Plain,
+                                     bool prefetch = false) {
+  uint64_t value = prefetch;
+  value = (value << 2) | (format & 3);
+  value = (value << 2) | (join & 3);
+  value = (value << 1) | associate;
   value = (value << 1) | dim;
   value = (value << 1) | penetrate;
   value = (value << 3) | ind;
@@ -177,12 +195,15 @@ inline uint64_t INDIRECT_STREAM_MASK(int port,
  * \param operation 0: read, 1: write, 2-7: atomic +, -, *, /, min, and max.
  * \param memory 0: memory, 1: spad.
  * \param dtype The data type of this stream.
+ * \param termination If the stream ends at a sentinel of dtype, where length is the max length.
+ *                    Refer rf.h:StreamTermination for more details.
  */
 inline void INSTANTIATE_1D_STREAM(REG addr, REG stride, REG length,
                                   int port, int padding, int action, int operation,
-                                  int memory, int dtype, int ctype) {
+                                  int memory, int dtype, int ctype,
+                                  int termination = DST_Length) {
   CONFIG_1D_STREAM(addr, stride, length, dtype, ctype);
-  auto value = LINEAR_STREAM_MASK(port, padding, action, /*1d*/0, operation, memory);
+  auto value = LINEAR_STREAM_MASK(port, padding, action, /*1d*/0, operation, memory, termination);
   INTRINSIC_R("ss_lin_strm", value);
 }
 
@@ -218,6 +239,30 @@ inline void SS_WAIT_ALL() {
 }
 
 
+/*!
+ * \brief Block the control host until the given number of harts all reach this barrier.
+ *        It is the ss_wait of isa.ext with bit 7 of the immediate set, whose rs1 holds the
+ *        number of harts instead of a barrier mask.
+ * \param num_threads The number of harts meeting at the barrier.
+ */
+inline void SS_GLOBAL_WAIT(REG num_threads) {
+  REG x0((uint64_t) 0);
+  INTRINSIC_DRI("ss_wait", x0, num_threads, (uint64_t) 128);
+}
+
+
+/*!
+ * \brief Poll the status of the accelerator without blocking the control host.
+ * \param mask The same barrier mask as SS_WAIT.
+ * \return Non-zero if SS_WAIT with the same mask would not block.
+ */
+inline REG SS_POLL(REG mask) {
+  REG res;
+  INTRINSIC_DRI("ss_stat", res, mask, (uint64_t) 0);
+  return res;
+}
+
+
 /*!
  * \brief Write a value from CGRA to the register file.
  * \param out_port: The source port.
@@ -248,6 +293,24 @@ inline void SS_RECURRENCE(int oport, int iport, REG n, int dtype = 8) {
   INTRINSIC_R("ss_wr_rd", port);
 }
 
+/*!
+ * \brief Forward value from the output port of the current lanes to the input port of the
+ *        adjacent lane on the ring, i.e. the right of the last lane is the first lane.
+ *        Unlike the legacy SS_XFER_LEFT/SS_XFER_RIGHT, the ports are in the register, so they
+ *        need not be compile-time constants.
+ * \param oport: The data source port in the current lane.
+ * \param iport: The destination data port in the adjacent lane.
+ * \param n: The number of data forwarded.
+ * \param dir: The adjacent lane, refer LaneTransfer.
+ * \param dtype: The data type of each element forwarded.
+ */
+inline void SS_XFER(int oport, int iport, REG n, LaneTransfer dir, int dtype = 8) {
+  CONFIG_PARAM(DSARF::L1D, n, false, DSARF::CSR, _LOG2(dtype), false);
+  CONFIG_PARAM(DSARF::I1D, (uint64_t) 1, false);
+  REG port(iport | (oport << 7) | ((uint64_t) dir << 14));
+  INTRINSIC_R("ss_wr_rd", port);
+}
+
 
 /*!
  * \brief Set the registers that related to 2d stream.
@@ -270,9 +333,9 @@ inline void CONFIG_2D_STREAM(REG addr, REG stride1d, REG length,
  */
 inline void INSTANTIATE_2D_STREAM(REG addr, REG stride1d, REG l1d, REG stride2d, REG stretch, REG n,
                                   int port, int padding, int action, int op, int mem,
-                                  int dtype, int ctype) {
+                                  int dtype, int ctype, int termination = DST_Length) {
   CONFIG_2D_STREAM(addr, stride1d, l1d, stride2d, stretch, n, dtype, ctype);
-  auto value = LINEAR_STREAM_MASK(port, padding, action, /*2d*/1, op, mem);
+  auto value = LINEAR_STREAM_MASK(port, padding, action, /*2d*/1, op, mem, termination);
   INTRINSIC_R("ss_lin_strm", value);
 }
 
@@ -331,12 +394,89 @@ inline void SS_2D_CONST(int port, REG v1, REG r1, REG v2, REG r2, REG iters, int
                         /*n3d*/iters, port, 0, DSA_Generate, 0, 0, 1, cbyte);
 }
 
+/*!
+ * \brief The reorder buffer of the next indirect stream.
+ * \param rob_size The number of requests in flight, 0 for DEFAULT_IND_ROB_SIZE.
+ * \param unordered If the elements may arrive at the port out of the index order,
+ *                  e.g. when they are consumed by a commutative reduction or an atomic update.
+ */
+inline uint64_t IND_ROB_MASK(int rob_size, bool unordered) {
+  return (rob_size & 0xffff) | ((uint64_t) unordered << 16);
+}
+
+/*!
+ * \brief The offset list of an indirect stream gathering several fields at each index.
+ *        The byte offset of field i is bits [8i, 8i+8), the port of field i is
+ *        bits [32+7i, 39+7i), and the number of fields minus one is bits [60, 62).
+ * \param n The number of fields, at most 4.
+ * \param offsets The byte offsets of the fields to the indexed element, less than 256.
+ * \param ports The destination port of each field.
+ */
+inline uint64_t OFL_MASK(int n, const int *offsets, const int *ports) {
+  uint64_t value = (uint64_t) ((n - 1) & 3) << 60;
+  for (int i = 0; i < n && i < 4; ++i) {
+    value |= (uint64_t) (offsets[i] & 255) << (i * 8);
+    value |= (uint64_t) (ports[i] & 127) << (32 + i * 7);
+  }
+  return value;
+}
+
+/*!
+ * \brief The cycles of a random memory access, which an indirect stream issuing a request per
+ *        cycle should cover by the requests in flight.
+ */
+#ifndef DSA_IND_MEM_LATENCY
+#define DSA_IND_MEM_LATENCY 64
+#endif
+
+/*!
+ * \brief The reorder buffer size for an indirect stream of len elements: the requests in flight
+ *        covering DSA_IND_MEM_LATENCY, but no more than the elements of the stream, nor than
+ *        MAX_MEM_REQS, and at least DEFAULT_IND_ROB_SIZE.
+ */
+inline int IND_ROB_SIZE(uint64_t len) {
+  uint64_t res = DSA_IND_MEM_LATENCY < MAX_MEM_REQS ? DSA_IND_MEM_LATENCY : MAX_MEM_REQS;
+  res = len < res ? len : res;
+  return res > DEFAULT_IND_ROB_SIZE ? res : DEFAULT_IND_ROB_SIZE;
+}
+
+/*!
+ * \brief The quality of service of the next memory stream.
+ * \param priority Refer rf.h:StreamPriority for more details.
+ * \param max_reqs The most requests the stream may have in flight, i.e. its share of
+ *                 MAX_MEM_REQS, 0 for no cap.
+ */
+inline uint64_t QOS_MASK(StreamPriority priority, int max_reqs) {
+  return (priority & 3) | ((uint64_t) (max_reqs & 0xffff) << 8);
+}
+
+/*!
+ * \brief Set the quality of service of the next stream, e.g. a latency-critical gather issued
+ *        while a bulk DMA is running. Streams without it are DSP_Normal without a cap.
+ * \param sticky If it applies to all the streams after, until it is set again.
+ */
+inline void SS_STREAM_QOS(StreamPriority priority, int max_reqs = 0, bool sticky = false) {
+  CONFIG_PARAM(DSARF::QOS, QOS_MASK(priority, max_reqs), sticky);
+}
+
 /*!
  * \brief Instantiate a 1d indirect stream a[b[i]]
+ * \param rob_size The reorder buffer size of this stream. Refer IND_ROB_MASK.
+ * \param unordered If the elements may arrive out of order. Refer IND_ROB_MASK.
+ * \param offset_list The fields gathered at each index. Refer OFL_MASK.
+ *                    If 0, the element at each index is gathered to target_port.
  */
 inline void INSTANTIATE_1D_INDIRECT(int target_port, int target_type, int idx_port, int index_type,
                                     REG start, REG stride1d, REG len, int memory,
-                                    MemoryOperation operation, bool penetrate, bool associate = false) {
+                                    MemoryOperation operation, bool penetrate, bool associate = false,
+                                    int rob_size = 0, bool unordered = false,
+                                    uint64_t offset_list = 0) {
+  if (rob_size || unordered) {
+    CONFIG_PARAM(DSARF::IRB, IND_ROB_MASK(rob_size, unordered), 0);
+  }
+  if (offset_list) {
+    CONFIG_PARAM(DSARF::OFL, offset_list, 0);
+  }
   CONFIG_PARAM(DSARF::INDP, idx_port, 0, DSARF::SAR, start, 0);
   CONFIG_PARAM(DSARF::L1D, len, 0, DSARF::CSR, DTYPE_MASK(target_type, 0, index_type), 0);
   CONFIG_PARAM(DSARF::I1D, stride1d, 0);
@@ -344,6 +484,65 @@ inline void INSTANTIATE_1D_INDIRECT(int target_port, int target_type, int idx_po
   INTRINSIC_R("ss_ind_strm", value);
 }
 
+/*!
+ * \brief Instantiate a 1d indirect stream a[b[i]], where b is a compressed index stream
+ *        decoded by the indirect stream engine. The idx_port is fed with 8-byte words.
+ * \param format The format of the index stream. Refer rf.h:IndexFormat for more details.
+ * \param log_block The log2 of the block size of DIF_DeltaPacked.
+ * \param len The number of decoded indices.
+ * \param rob_size The reorder buffer size of this stream. Refer IND_ROB_MASK.
+ * \param unordered If the elements may arrive out of order. Refer IND_ROB_MASK.
+ */
+inline void INSTANTIATE_1D_INDIRECT_PACKED(int target_port, int target_type, int idx_port,
+                                           int format, int log_block, REG start, REG stride1d,
+                                           REG len, int memory, MemoryOperation operation,
+                                           bool penetrate, bool associate = false,
+                                           int rob_size = 0, bool unordered = false) {
+  if (rob_size || unordered) {
+    CONFIG_PARAM(DSARF::IRB, IND_ROB_MASK(rob_size, unordered), 0);
+  }
+  CONFIG_PARAM(DSARF::INDP, idx_port, 0, DSARF::SAR, start, 0);
+  CONFIG_PARAM(DSARF::L1D, len, 0, DSARF::CSR, DTYPE_MASK(target_type, 0, 8), 0);
+  CONFIG_PARAM(DSARF::I1D, stride1d, 0, DSARF::ICF, log_block, 0);
+  auto value = INDIRECT_STREAM_MASK(target_port, memory, 1, 0, operation, penetrate, associate,
+                                    DJM_None, format);
+  INTRINSIC_R("ss_ind_strm", value);
+}
+
+/*!
+ * \brief Prefetch addr[0:bytes] into the cache of the memory, for the host to walk it later.
+ *        No data is delivered to a port, so the stream needs no configuration to drain it.
+ */
+inline void SS_PREFETCH_1D(REG addr, REG bytes) {
+  CONFIG_1D_STREAM(addr, (uint64_t) 1, bytes, 1, 0);
+  auto value = LINEAR_STREAM_MASK(0, DP_NoPadding, DSA_Access, /*1d*/0, DMO_Read, DMT_DMA,
+                                  DST_Length, /*prefetch*/true);
+  INTRINSIC_R("ss_lin_strm", value);
+}
+
+/*!
+ * \brief Prefetch n rows of the given bytes, addr + i*stride, e.g. the results of a
+ *        SS_DMA_2D_WRITE to be postprocessed by the host.
+ */
+inline void SS_PREFETCH_2D(REG addr, REG stride, REG bytes, REG n) {
+  CONFIG_2D_STREAM(addr, (uint64_t) 1, bytes, stride, (uint64_t) 0, n, 1, 0);
+  auto value = LINEAR_STREAM_MASK(0, DP_NoPadding, DSA_Access, /*2d*/1, DMO_Read, DMT_DMA,
+                                  DST_Length, /*prefetch*/true);
+  INTRINSIC_R("ss_lin_strm", value);
+}
+
+/*!
+ * \brief Prefetch a[b[i]] of len elements, where the indices of itype bytes come from idx_port.
+ */
+inline void SS_PREFETCH_INDIRECT(int idx_port, int itype, REG start, int dtype, REG len) {
+  CONFIG_PARAM(DSARF::INDP, idx_port, 0, DSARF::SAR, start, 0);
+  CONFIG_PARAM(DSARF::L1D, len, 0, DSARF::CSR, DTYPE_MASK(dtype, 0, itype), 0);
+  CONFIG_PARAM(DSARF::I1D, (uint64_t) 1, 0);
+  auto value = INDIRECT_STREAM_MASK(0, DMT_DMA, 1, 0, DMO_Read, false, false, DJM_None,
+                                    DIF_Plain, /*prefetch*/true);
+  INTRINSIC_R("ss_ind_strm", value);
+}
+
 /*!
  * \brief Allocate [start, end) on the spad to be buffet buffer.
  * \param start The close set of the starting address.
@@ -426,6 +625,20 @@ struct Indirect2DAttr {
    * \brief If a address generation, the dtype of the stream.
    */
   int ctype{0};
+  /*!
+   * \brief The reorder buffer size, 0 for DEFAULT_IND_ROB_SIZE. Refer IND_ROB_MASK.
+   */
+  int rob_size{0};
+  /*!
+   * \brief If the elements may arrive at the port out of order. Refer IND_ROB_MASK.
+   */
+  bool unordered{false};
+  /*!
+   * \brief The quality of service, e.g. DSP_Critical for a gather on the critical path.
+   *        Refer QOS_MASK.
+   */
+  StreamPriority priority{DSP_Normal};
+  int max_reqs{0};
 };
 
 /*!
@@ -441,6 +654,12 @@ inline void SS_INDIRECT_2D_READ(const Indirect2DAttr *i2a) {
   l1d_port = l1d_port == -1 ? 0 : l1d_port;
   start_port = start_port == -1 ? 0 : start_port;
   int port_mask = (idx_port) | (start_port << 7) | (l1d_port << 14);
+  if (i2a->rob_size || i2a->unordered) {
+    CONFIG_PARAM(DSARF::IRB, IND_ROB_MASK(i2a->rob_size, i2a->unordered), 0);
+  }
+  if (i2a->priority != DSP_Normal || i2a->max_reqs) {
+    SS_STREAM_QOS(i2a->priority, i2a->max_reqs);
+  }
   CONFIG_PARAM(DSARF::INDP, port_mask, 0, DSARF::L1D, i2a->l1d, 0);
   int dtype_mask =
     DTYPE_MASK(i2a->dtype, i2a->ctype, i2a->idx_dtype, i2a->start_dtype, i2a->l1d_dtype);
@@ -451,3 +670,89 @@ inline void SS_INDIRECT_2D_READ(const Indirect2DAttr *i2a) {
   INTRINSIC_R("ss_ind_strm", value);
 }
 
+
+/*!
+ * \brief The attributes of a join stream, which co-iterates two sorted index lists a and b
+ *        in m segments. The positions count from the beginning of each index stream.
+ * \code{c}
+ *   for (s=0; s<m; ++s)
+ *     for (i=0, j=0; i<na[s] || j<nb[s]; )
+ *       if (j == nb[s] || i < na[s] && a[i] < b[j]) union ? emit(a[i], i, none) : 0, ++i;
+ *       else if (i == na[s] || b[j] < a[i]) union ? emit(b[j], none, j) : 0, ++j;
+ *       else emit(a[i], i, j), ++i, ++j;
+ * \endcode
+ *        Each emit sends the index to key_port, and the positions to a_out_port and b_out_port.
+ *        If a_val (b_val) is given, a_val[i] (b_val[j]) is sent instead of the position.
+ *        A missing side of the union is sent as 0 for a value, or all ones for a position.
+ */
+struct JoinAttr {
+  JoinMode mode{DJM_Intersect};
+  /*!
+   * \brief The ports and types of the sorted index lists.
+   */
+  int a_port, a_dtype;
+  int b_port, b_dtype;
+  /*!
+   * \brief The ports and type of the lengths na[s] and nb[s] of each segment.
+   */
+  int a_len_port{-1}, b_len_port{-1}, len_dtype{0};
+  /*!
+   * \brief The lengths can optionally be constants when the length ports are -1.
+   *        A single bit of the stream selects the ports, so either both of the lengths are
+   *        from the ports, or both of them are constants.
+   */
+  REG a_len, b_len;
+  /*!
+   * \brief The value of m.
+   */
+  REG l2d{(uint64_t) 1};
+  /*!
+   * \brief The destination ports of the joined index and the positions, -1 if not emitted.
+   */
+  int key_port{-1}, a_out_port{-1}, b_out_port{-1};
+  /*!
+   * \brief The data type of the positions.
+   */
+  int ctype{8};
+  /*!
+   * \brief The optional values of a and b, gathered by the positions.
+   */
+  REG a_val{(uint64_t) 0}, b_val{(uint64_t) 0};
+  /*!
+   * \brief The data type of the values.
+   */
+  int dtype{8};
+  /*!
+   * \brief The type of memory.
+   */
+  int memory{DMT_DMA};
+};
+
+/*!
+ * \brief Instantiate a join stream.
+ *        The ports of the index lists and lengths are encoded in INDP, and the destination
+ *        ports in JNP. a_val and b_val are held by SAR and I2D, and the constant lengths by
+ *        L1D and IL1D.
+ * \param ja The attributes of a join stream.
+ */
+inline void SS_JOIN(const JoinAttr *ja) {
+  assert((ja->a_len_port == -1) == (ja->b_len_port == -1));
+  int a_len_port = ja->a_len_port == -1 ? 0 : ja->a_len_port;
+  int b_len_port = ja->b_len_port == -1 ? 0 : ja->b_len_port;
+  int ind_mode = (ja->a_val.value != 0) | (ja->b_val.value != 0) * 2 | (ja->a_len_port != -1) * 4;
+  uint64_t in_mask = ja->a_port | (ja->b_port << 7) | (a_len_port << 14) | (b_len_port << 21);
+  uint64_t out_mask = 0;
+  int outs[] = {ja->key_port, ja->a_out_port, ja->b_out_port};
+  for (int i = 0; i < 3; ++i) {
+    if (outs[i] != -1) {
+      out_mask |= ((uint64_t) outs[i] << (i * 7)) | (1ull << (21 + i));
+    }
+  }
+  CONFIG_PARAM(DSARF::INDP, in_mask, 0, DSARF::JNP, out_mask, 0);
+  CONFIG_PARAM(DSARF::L1D, ja->a_len, 0, DSARF::IL1D, ja->b_len, 0);
+  int dtype_mask = DTYPE_MASK(ja->dtype, ja->ctype, ja->a_dtype, ja->b_dtype, ja->len_dtype);
+  CONFIG_PARAM(DSARF::L2D, ja->l2d, 0, DSARF::CSR, dtype_mask, 0);
+  CONFIG_PARAM(DSARF::SAR, ja->a_val, 0, DSARF::I2D, ja->b_val, 0);
+  auto value = INDIRECT_STREAM_MASK(0, ja->memory, ind_mode, 1, DMO_Read, false, false, ja->mode);
+  INTRINSIC_R("ss_ind_strm", value);
+}
@@ -0,0 +1,260 @@
+/*!
+ * \file mmap_plan.h
+ * \author PolyArch Research Lab
+ * \brief A planner that recommends the map type and the partition size of SS_CONFIG_MEM_MAP
+ *        from the sizes of the shared data structures and the accesses of each core.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The max number of addresses sampled from each access pattern.
+ */
+#ifndef DSA_PLAN_SAMPLES
+#define DSA_PLAN_SAMPLES 4096
+#endif
+
+/*!
+ * \brief The cost of a remote access relative to a local bank access.
+ *        By default, a remote access occupies a network packet for a single word.
+ */
+#ifndef DSA_PLAN_REMOTE_COST
+#define DSA_PLAN_REMOTE_COST (SPU_NET_PACKET_SIZE / DATA_WIDTH)
+#endif
+
+/*!
+ * \brief The accesses of a core to a data structure. The addresses are offsets to the
+ *        data structure, which is either affine or sampled from an index stream.
+ * \code{c}
+ *   for (i=0; i<n; ++i)
+ *     idx ? a[idx[i]*stride] : a[i*stride]
+ * \endcode
+ */
+struct MemMapAccess {
+  /*!
+   * \brief The core issuing the accesses.
+   */
+  int core;
+  /*!
+   * \brief The index of the accessed data structure.
+   */
+  int data;
+  /*!
+   * \brief The byte offset of the first access.
+   */
+  uint64_t start{0};
+  /*!
+   * \brief The stride in bytes between the accesses, or the size of each indexed element.
+   */
+  uint64_t stride;
+  /*!
+   * \brief The number of accesses.
+   */
+  uint64_t n;
+  /*!
+   * \brief The sampled index stream. nullptr for an affine access pattern.
+   */
+  const uint64_t *idx{nullptr};
+};
+
+/*!
+ * \brief The recommended memory map.
+ */
+struct MemMapPlan {
+  int map_type;
+  uint64_t part_size;
+  /*!
+   * \brief The fraction of the sampled accesses to a remote core.
+   */
+  double remote;
+  /*!
+   * \brief The max bank load over the mean bank load.
+   */
+  double imbalance;
+  /*!
+   * \brief The estimated cost in the unit of a local bank access, or negative if the sizes or
+   *        the accesses planned are invalid.
+   */
+  double cost;
+};
+
+/*! \brief The step between the addresses sampled from n accesses. */
+inline uint64_t _PLAN_STEP(uint64_t n) {
+  return n > DSA_PLAN_SAMPLES ? n / DSA_PLAN_SAMPLES : 1;
+}
+
+/*!
+ * \brief If the data structures are not empty, and each access is to a data structure, within
+ *        its size.
+ */
+inline bool _PLAN_VALID(const uint64_t *sizes, int n_data, const MemMapAccess *acc, int n_acc) {
+  for (int i = 0; i < n_data; ++i) {
+    if (!sizes[i]) {
+      return false;
+    }
+  }
+  for (int i = 0; i < n_acc; ++i) {
+    const MemMapAccess *a = acc + i;
+    if (a->data < 0 || a->data >= n_data) {
+      return false;
+    }
+    if (!a->n) {
+      continue;
+    }
+    uint64_t size = sizes[a->data];
+    if (a->start >= size) {
+      return false;
+    }
+    // The bytes of the data structure after the first access.
+    uint64_t room = size - 1 - a->start;
+    // The last of the affine accesses, or each of the sampled ones.
+    uint64_t step = a->idx ? _PLAN_STEP(a->n) : a->n;
+    for (uint64_t j = a->idx ? 0 : a->n - 1; j < a->n; j += step) {
+      uint64_t k = a->idx ? a->idx[j] : j;
+      if (a->stride && k > room / a->stride) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/*!
+ * \brief The (core, bank) an offset of the shared region is mapped to. The planner models
+ *        the map types as below, where a region of size bytes is distributed across c cores.
+ *        PART_CORE_BANK_REST: partitions of part_size bytes are dealt to the cores round-robin,
+ *                             and consecutive words of a core are interleaved across the banks.
+ *        PART_CORE_REST_BANK: partitions are dealt the same way, but each bank holds a
+ *                             contiguous slice of the part of a core.
+ *        CORE_PART_BANK_REST: each core holds a contiguous size/c block, and consecutive
+ *                             words of a core are interleaved across the banks.
+ */
+inline void _PLAN_LOCATE(uint64_t addr, uint64_t size, int cores, int map_type,
+                         uint64_t part_size, int &core, int &bank) {
+  uint64_t per_core = (size + cores - 1) / cores;
+  uint64_t local;
+  if (map_type == CORE_PART_BANK_REST) {
+    core = addr / per_core;
+    local = addr % per_core;
+  } else {
+    core = (addr / part_size) % cores;
+    local = addr / (part_size * cores) * part_size + addr % part_size;
+  }
+  if (map_type == PART_CORE_REST_BANK) {
+    uint64_t slice = (per_core + NUM_SCRATCH_BANKS - 1) / NUM_SCRATCH_BANKS;
+    bank = local / (slice ? slice : 1);
+  } else {
+    bank = (local / DATA_WIDTH) % NUM_SCRATCH_BANKS;
+  }
+}
+
+/*!
+ * \brief Evaluate a candidate map. The data structures are laid out back to back.
+ *        The loads, the remote accesses and the total count the accesses, not the samples.
+ */
+inline MemMapPlan _PLAN_EVAL(const uint64_t *sizes, int n_data, int cores,
+                             const MemMapAccess *acc, int n_acc,
+                             int map_type, uint64_t part_size, uint64_t *load) {
+  uint64_t size = 0;
+  for (int i = 0; i < n_data; ++i) {
+    size += sizes[i];
+  }
+  for (int i = 0; i < cores * NUM_SCRATCH_BANKS; ++i) {
+    load[i] = 0;
+  }
+  uint64_t remote = 0, total = 0;
+  for (int i = 0; i < n_acc; ++i) {
+    const MemMapAccess *a = acc + i;
+    uint64_t base = 0;
+    for (int j = 0; j < a->data; ++j) {
+      base += sizes[j];
+    }
+    uint64_t step = _PLAN_STEP(a->n);
+    for (uint64_t j = 0; j < a->n; j += step) {
+      uint64_t offset = a->start + (a->idx ? a->idx[j] : j) * a->stride;
+      int core, bank;
+      _PLAN_LOCATE(base + offset, size, cores, map_type, part_size, core, bank);
+      // Each sample stands for the accesses up to the next one, so the accesses weigh the same.
+      uint64_t weight = a->n - j < step ? a->n - j : step;
+      load[core * NUM_SCRATCH_BANKS + bank] += weight;
+      remote += core != a->core ? weight : 0;
+      total += weight;
+    }
+  }
+  uint64_t max_load = 0;
+  for (int i = 0; i < cores * NUM_SCRATCH_BANKS; ++i) {
+    max_load = load[i] > max_load ? load[i] : max_load;
+  }
+  double mean = (double) total / (cores * NUM_SCRATCH_BANKS);
+  MemMapPlan res;
+  res.map_type = map_type;
+  res.part_size = part_size;
+  res.remote = total ? (double) remote / total : 0;
+  res.imbalance = total ? max_load / mean : 1;
+  // The banks work in parallel, and the remote accesses share the network links of all the cores.
+  res.cost = max_load + (double) DSA_PLAN_REMOTE_COST * remote / cores;
+  return res;
+}
+
+/*!
+ * \brief Recommend the memory map minimizing the remote traffic and the bank imbalance.
+ *        The partition sizes enumerated are powers of two, from a word to the even share of
+ *        a core. CORE_PART_BANK_REST is only considered when all the sizes are powers of two.
+ * \param sizes The sizes of the data structures in bytes.
+ * \param n_data The number of data structures.
+ * \param cores The number of cores sharing the data structures.
+ * \param acc The accesses of the cores.
+ * \param n_acc The number of accesses.
+ * \return The plan, whose cost is negative if a data structure is empty, or an access is out
+ *         of its data structure.
+ */
+inline MemMapPlan DSA_PLAN_MEM_MAP(const uint64_t *sizes, int n_data, int cores,
+                                   const MemMapAccess *acc, int n_acc) {
+  MemMapPlan best;
+  best.map_type = PART_CORE_BANK_REST;
+  best.part_size = DATA_WIDTH;
+  best.remote = 0;
+  best.imbalance = 1;
+  best.cost = -1;
+  if (!_PLAN_VALID(sizes, n_data, acc, n_acc)) {
+    return best;
+  }
+  uint64_t total = 0;
+  bool pow2 = true;
+  for (int i = 0; i < n_data; ++i) {
+    total += sizes[i];
+    pow2 &= (sizes[i] & (sizes[i] - 1)) == 0;
+  }
+  cores = cores < 1 ? 1 : cores < DSA_MAX_HARTS ? cores : DSA_MAX_HARTS;
+  std::vector<uint64_t> load(cores * NUM_SCRATCH_BANKS);
+  int types[] = {PART_CORE_BANK_REST, PART_CORE_REST_BANK, CORE_PART_BANK_REST};
+  for (int map_type : types) {
+    if (map_type == CORE_PART_BANK_REST && !pow2) {
+      continue;
+    }
+    for (uint64_t part = DATA_WIDTH; part == DATA_WIDTH || part * cores <= total; part <<= 1) {
+      MemMapPlan cand = _PLAN_EVAL(sizes, n_data, cores, acc, n_acc, map_type, part, load.data());
+      if (best.cost < 0 || cand.cost < best.cost) {
+        best = cand;
+      }
+      if (map_type == CORE_PART_BANK_REST) {
+        // The partition size does not affect this map type in the model.
+        break;
+      }
+    }
+  }
+  return best;
+}
+
+/*!
+ * \brief Apply the planned memory map to the given cores.
+ * \param active_core_bv The bitmask of the cores sharing the data structures.
+ */
+inline void DSA_APPLY_MEM_MAP(const MemMapPlan *plan, uint64_t active_core_bv) {
+  SS_MEM_MAP(plan->part_size, active_core_bv, plan->map_type);
+}
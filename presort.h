@@ -0,0 +1,115 @@
+/*!
+ * \file presort.h
+ * \author PolyArch Research Lab
+ * \brief Presorting the indices of a gather by memory line. The distinct indices are sorted,
+ *        so that a gather of them fetches each MEM_WIDTH line once, and a permutation stream
+ *        restores the original order from the gathered values in the scratchpad.
+ *        The preprocessing runs on the host once, and is reused by the repeated gathers
+ *        over the same index set.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <utility>
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief A presorted index set.
+ */
+struct PresortedIndex {
+  /*!
+   * \brief The number of indices, and the number of distinct ones.
+   */
+  uint64_t n, unique;
+  /*!
+   * \brief The distinct indices in the ascending order, of 8 bytes each.
+   */
+  uint64_t *sorted;
+  /*!
+   * \brief The position in sorted of each original index, of 4 bytes each.
+   */
+  uint32_t *perm;
+  /*!
+   * \brief The number of distinct MEM_WIDTH lines touched, and the number of line changes
+   *        of the original order, i.e. the line fetches of a gather without the presort.
+   */
+  uint64_t lines, fetches;
+};
+
+/*!
+ * \brief Presort the indices a[idx[i]*stride].
+ * \param idx The indices of itype bytes each.
+ * \param stride The bytes between two consecutive indices, i.e. the size of the elements.
+ * \param sorted The buffer of n words of the distinct indices.
+ * \param perm The buffer of n entries of the permutation.
+ * \param pairs A scratch buffer of n (index, position) pairs.
+ */
+inline void DSA_PRESORT(PresortedIndex *pi, const void *idx, int itype, uint64_t n,
+                        uint64_t stride, uint64_t *sorted, uint32_t *perm,
+                        std::pair<uint64_t, uint64_t> *pairs) {
+  pi->n = n;
+  pi->sorted = sorted;
+  pi->perm = perm;
+  pi->unique = pi->lines = pi->fetches = 0;
+  uint64_t prev_line = ~0ull;
+  for (uint64_t i = 0; i < n; ++i) {
+    uint64_t v;
+    switch (itype) {
+      case 1: v = ((const uint8_t*) idx)[i]; break;
+      case 2: v = ((const uint16_t*) idx)[i]; break;
+      case 4: v = ((const uint32_t*) idx)[i]; break;
+      default: v = ((const uint64_t*) idx)[i]; break;
+    }
+    pairs[i] = {v, i};
+    uint64_t line = v * stride / MEM_WIDTH;
+    pi->fetches += line != prev_line;
+    prev_line = line;
+  }
+  std::sort(pairs, pairs + n);
+  prev_line = ~0ull;
+  for (uint64_t i = 0; i < n; ++i) {
+    if (!pi->unique || sorted[pi->unique - 1] != pairs[i].first) {
+      sorted[pi->unique++] = pairs[i].first;
+      uint64_t line = pairs[i].first * stride / MEM_WIDTH;
+      pi->lines += line != prev_line;
+      prev_line = line;
+    }
+    perm[pairs[i].second] = pi->unique - 1;
+  }
+}
+
+/*!
+ * \brief If the presort saves enough line fetches to pay for the restore pass, which moves
+ *        the n gathered elements once more through the scratchpad.
+ */
+inline bool DSA_PRESORT_PROFITABLE(const PresortedIndex *pi, uint64_t stride) {
+  uint64_t restore = (pi->n * (stride + 4) + MEM_WIDTH - 1) / MEM_WIDTH;
+  return pi->lines + restore < pi->fetches;
+}
+
+/*!
+ * \brief Gather a[idx[i]*stride] in the original order by the presorted indices.
+ *        The distinct elements are gathered in the line order into buf in the scratchpad,
+ *        and then read back by the permutation.
+ *        The spatial configuration is expected to pass in_port through to out_port.
+ * \param a The array gathered, in the main memory.
+ * \param dtype The data type of the elements, which is also the stride.
+ * \param buf The scratchpad buffer of pi->unique elements.
+ * \param dest_port The port of the gathered elements in the original order.
+ * \param ind_idx The indirect port of the sorted indices.
+ * \param ind_perm The indirect port of the permutation.
+ */
+DSA_INLINE void SS_PRESORTED_GATHER(const PresortedIndex *pi, REG a, int dtype, REG buf,
+                                    int in_port, int out_port, int dest_port,
+                                    int ind_idx = P_IND_1, int ind_perm = P_IND_2) {
+  SS_1D_READ(pi->sorted, pi->unique * 8, ind_idx, DP_NoPadding, DMT_DMA, 8);
+  SS_INDIRECT_READ(in_port, dtype, ind_idx, 8, a, 1, pi->unique, DMT_DMA, false, false);
+  SS_1D_WRITE(out_port, buf, pi->unique * dtype, DMT_SPAD, dtype);
+  REG written((uint64_t) (1 << DBF_SPadStreams));
+  SS_WAIT(written);
+  SS_1D_READ(pi->perm, pi->n * 4, ind_perm, DP_NoPadding, DMT_DMA, 4);
+  SS_INDIRECT_READ(dest_port, dtype, ind_perm, 4, buf, 1, pi->n, DMT_SPAD, false, false);
+}
@@ -0,0 +1,188 @@
+/*!
+ * \file reduce.h
+ * \author PolyArch Research Lab
+ * \brief Pipelined reductions and scans over the loop-carried dependence of SS_RECURRENCE.
+ *        A single accumulator recurred from the output to the input is bound by the latency
+ *        of the recurrence, one element per round trip. Instead, DSA_REDUCE_ACCS independent
+ *        accumulators are interleaved, so that element i is combined with the output of
+ *        element i-K, and the recurrence is in flight for K elements at a time.
+ *        The ports should be compile-time constants.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The independent accumulators interleaved, which should cover the latency of the
+ *        recurrence in elements, i.e. its cycles times the lanes of the ports.
+ */
+#ifndef DSA_REDUCE_ACCS
+#define DSA_REDUCE_ACCS 8
+#endif
+
+/*!
+ * \brief The ports of a reduction. The configuration is expected to compute
+ * \code{c}
+ *   out_port = copy_port = in_port (op) acc_port
+ * \endcode
+ *        element-wise, where (op) is associative, e.g. the sum of the products of a dot
+ *        product computed upstream and recurred to in_port.
+ *        The copy port is only required by the scans, which both write and recur each
+ *        output. A reduction discards it, if any.
+ */
+struct ReducePorts {
+  int in_port, acc_port, out_port;
+  int copy_port{-1};
+};
+
+/*! \brief The accumulators of n elements, at most one per element. */
+inline uint64_t _REDUCE_ACCS(uint64_t n) {
+  return n < DSA_REDUCE_ACCS ? n : DSA_REDUCE_ACCS;
+}
+
+/*! \brief Discard n elements of the copy port, if the configuration has one. */
+DSA_INLINE void _REDUCE_DROP_COPY(const ReducePorts *p, uint64_t n, int dtype) {
+  if (p->copy_port >= 0 && n) {
+    SS_GARBAGE_GENERAL(p->copy_port, n, dtype);
+  }
+}
+
+/*!
+ * \brief Fold the k partials on the output port into one, left on the output port.
+ *        Each round combines the partial j with the partial j-ceil(c/2), and halves them on
+ *        the fabric, so that the host only receives the result.
+ */
+DSA_INLINE void _REDUCE_FOLD(const ReducePorts *p, uint64_t k, uint64_t identity, int dtype) {
+  if (k > 1) {
+    SS_RECURRENCE(p->out_port, p->in_port, k, dtype);
+  }
+  for (uint64_t c = k; c > 1;) {
+    uint64_t h = c / 2;
+    SS_CONST(p->acc_port, identity, c - h, dtype);
+    SS_RECURRENCE(p->out_port, p->acc_port, h, dtype);
+    if (c - h > 1) {
+      SS_RECURRENCE(p->out_port, p->in_port, c - h, dtype);
+    }
+    _REDUCE_DROP_COPY(p, c, dtype);
+    c -= h;
+  }
+}
+
+/*!
+ * \brief Reduce n elements fed to the input port by feed(), and receive the result.
+ * \param identity The identity element of (op), the initial value of each accumulator.
+ * \param feed The streams of the n elements to the input port, e.g. a read, or the
+ *             recurrence of an upstream output.
+ */
+template<typename F>
+DSA_INLINE REG SS_REDUCE_FEED(const ReducePorts *p, uint64_t n, uint64_t identity, int dtype,
+                              F feed) {
+  if (!n) {
+    return identity;
+  }
+  uint64_t k = _REDUCE_ACCS(n);
+  feed();
+  SS_CONST(p->acc_port, identity, k, dtype);
+  if (n > k) {
+    SS_RECURRENCE(p->out_port, p->acc_port, n - k, dtype);
+  }
+  _REDUCE_DROP_COPY(p, n, dtype);
+  _REDUCE_FOLD(p, k, identity, dtype);
+  return SS_RECV(p->out_port, dtype);
+}
+
+/*!
+ * \brief Reduce addr[0:n], and receive the result.
+ */
+DSA_INLINE REG SS_REDUCE(const ReducePorts *p, REG addr, uint64_t n, uint64_t identity,
+                         int dtype = 8, MemoryType memory = DMT_DMA) {
+  return SS_REDUCE_FEED(p, n, identity, dtype, [&]() {
+    SS_1D_READ(addr, n * dtype, p->in_port, DP_NoPadding, memory, dtype);
+  });
+}
+
+/*!
+ * \brief Reduce each of the b rows of n elements, addr + i*ld, to res[i], written by a single
+ *        stream. The rows are interleaved column by column as the accumulators, so b should
+ *        be at least DSA_REDUCE_ACCS to hide the latency. The results are ready after a
+ *        barrier of the write streams.
+ * \param ld The elements between two rows.
+ */
+DSA_INLINE void SS_REDUCE_ROWS(const ReducePorts *p, REG addr, uint64_t ld, uint64_t b,
+                               uint64_t n, REG res, uint64_t identity, int dtype = 8,
+                               MemoryType memory = DMT_DMA) {
+  INSTANTIATE_2D_STREAM(addr, ld, b, (uint64_t) 1, (uint64_t) 0, n, p->in_port,
+                        DP_NoPadding, DSA_Access, DMO_Read, memory, dtype, 0);
+  SS_CONST(p->acc_port, identity, b, dtype);
+  if (n > 1) {
+    SS_RECURRENCE(p->out_port, p->acc_port, (n - 1) * b, dtype);
+  }
+  SS_1D_WRITE(p->out_port, res, b * dtype, memory, dtype);
+  _REDUCE_DROP_COPY(p, n * b, dtype);
+}
+
+/*!
+ * \brief The inclusive scan, dst[i] = src[0] (op) ... (op) src[i], of n elements.
+ *        The K interleaved accumulators scan K chunks of L = n/K elements each, in the first
+ *        pass. The totals of the chunks are scanned on the fabric to the offsets, each of which
+ *        is repeated over its chunk in the second pass, after a barrier of the first pass
+ *        written to dst. The last n%K elements are scanned by a single accumulator from the
+ *        total. The configuration should have the copy port, to both write and recur each
+ *        output. dst may be src.
+ */
+DSA_INLINE void SS_SCAN(const ReducePorts *p, REG src, REG dst, uint64_t n, uint64_t identity,
+                        int dtype = 8, MemoryType memory = DMT_DMA) {
+  if (!n) {
+    return;
+  }
+  uint64_t k = _REDUCE_ACCS(n);
+  uint64_t l = n / k;
+  uint64_t n0 = k * l;
+  uint64_t r = n - n0;
+  // The first pass, element j of each chunk at a time.
+  INSTANTIATE_2D_STREAM(src, l, k, (uint64_t) 1, (uint64_t) 0, l, p->in_port,
+                        DP_NoPadding, DSA_Access, DMO_Read, memory, dtype, 0);
+  SS_CONST(p->acc_port, identity, k, dtype);
+  if (n0 > k) {
+    SS_RECURRENCE(p->out_port, p->acc_port, n0 - k, dtype);
+  }
+  INSTANTIATE_2D_STREAM(dst, l, k, (uint64_t) 1, (uint64_t) 0, l, p->copy_port,
+                        DP_NoPadding, DSA_Access, DMO_Write, memory, dtype, 0);
+  // The scan of the totals of the chunks, by a single accumulator.
+  SS_RECURRENCE(p->out_port, p->in_port, k, dtype);
+  SS_CONST(p->acc_port, identity, 1, dtype);
+  if (k > 1) {
+    SS_RECURRENCE(p->out_port, p->acc_port, k - 1, dtype);
+  }
+  SS_GARBAGE_GENERAL(p->out_port, 1, dtype);
+  // The offset of chunk c is the scanned total of chunk c-1, repeated over chunk c.
+  if (k > 1) {
+    SS_REPEAT_PORT(p->acc_port, l);
+    SS_RECURRENCE(p->copy_port, p->acc_port, k - 1, dtype);
+  }
+  if (r) {
+    SS_RECURRENCE(p->copy_port, p->acc_port, 1, dtype);
+  } else {
+    SS_GARBAGE_GENERAL(p->copy_port, 1, dtype);
+  }
+  if (k > 1) {
+    REG barrier((uint64_t) ((1 << DBF_DMAStreams) | (1 << DBF_SPadStreams)));
+    SS_WAIT(barrier);
+    REG chunk1 = dst.value + l * dtype;
+    SS_1D_READ(chunk1, (n0 - l) * dtype, p->in_port, DP_NoPadding, memory, dtype);
+    SS_GARBAGE_GENERAL(p->out_port, n0 - l, dtype);
+    SS_1D_WRITE(p->copy_port, chunk1, (n0 - l) * dtype, memory, dtype);
+  }
+  if (r) {
+    REG tail_src = src.value + n0 * dtype;
+    REG tail_dst = dst.value + n0 * dtype;
+    SS_1D_READ(tail_src, r * dtype, p->in_port, DP_NoPadding, memory, dtype);
+    if (r > 1) {
+      SS_RECURRENCE(p->out_port, p->acc_port, r - 1, dtype);
+    }
+    SS_GARBAGE_GENERAL(p->out_port, 1, dtype);
+    SS_1D_WRITE(p->copy_port, tail_dst, r * dtype, memory, dtype);
+  }
+}
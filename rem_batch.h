@@ -0,0 +1,180 @@
+/*!
+ * \file rem_batch.h
+ * \author PolyArch Research Lab
+ * \brief Batched remote scratchpad writes. The (address, value) pairs are buffered per
+ *        destination core, and shipped as full network packets by SS_IND_REM_SCRATCH.
+ * \note SS_IND_REM_SCRATCH (ss_rem_port) and SS_WAIT_DF (ss_wait_df) are legacy encodings,
+ *       which are neither in isa.ext nor in the software model, so this header requires an
+ *       assembler that implements both, and does not build with DSA_SOFT_MODEL.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "dsaintrin.h"
+#include "mmap_plan.h"
+
+/*!
+ * \brief The number of (address, value) pairs carried by a network packet.
+ */
+#ifndef DSA_REM_PAIRS_PER_PACKET
+#define DSA_REM_PAIRS_PER_PACKET (SPU_NET_PACKET_SIZE / (2 * DATA_WIDTH))
+#endif
+
+/*!
+ * \brief The ports the pairs pass through. The spatial configuration is expected to pass the
+ *        input ports through to the output ports of the same numbers.
+ */
+#ifndef DSA_REM_ADDR_PORT
+#define DSA_REM_ADDR_PORT NET_ADDR_PORT
+#endif
+#ifndef DSA_REM_VAL_PORT
+#define DSA_REM_VAL_PORT NET_VAL_PORT
+#endif
+
+/*!
+ * \brief The number of remote writes each core expects, shared by all the cores.
+ */
+struct RemoteCounts {
+  std::atomic<uint64_t> incoming[DSA_MAX_HARTS]{};
+};
+
+/*! \brief Reset the counts, e.g. to reuse them after a failed phase. */
+inline void DSA_REM_COUNTS_INIT(RemoteCounts *counts) {
+  for (int i = 0; i < DSA_MAX_HARTS; ++i) {
+    counts->incoming[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+/*!
+ * \brief The state of the batched remote writes of a core.
+ *        Each destination core owns two halves of cap pairs in the buffer, so that one half
+ *        is filled by the host while the other one is being shipped.
+ */
+struct RemoteBatch {
+  /*!
+   * \brief The number of cores, and the core owning this batch.
+   */
+  int cores, self;
+  /*!
+   * \brief The memory map of the shared region. Refer _PLAN_LOCATE.
+   */
+  int map_type;
+  uint64_t part_size;
+  uint64_t region;
+  /*!
+   * \brief The base address of the remote scratchpad, and its type.
+   */
+  uint64_t scr_base;
+  int scratch_type{0};
+  /*!
+   * \brief The buffer of 4 * cores * cap words in the main memory.
+   */
+  uint64_t *buffer;
+  /*!
+   * \brief The pairs of each half, a multiple of DSA_REM_PAIRS_PER_PACKET.
+   */
+  uint64_t cap{DSA_REM_PAIRS_PER_PACKET * 4};
+  /*!
+   * \brief The half being filled and its number of pairs for each destination.
+   */
+  int half[DSA_MAX_HARTS];
+  uint64_t fill[DSA_MAX_HARTS];
+  /*!
+   * \brief The ship epoch of each half, and the epoch all the ships before are drained.
+   */
+  uint64_t shipped[DSA_MAX_HARTS][2];
+  uint64_t epoch, drained;
+  /*!
+   * \brief The pairs shipped to each destination since the last flush.
+   */
+  uint64_t sent[DSA_MAX_HARTS];
+};
+
+/*! \brief Reset the state of the batches. */
+inline void DSA_REM_INIT(RemoteBatch *rb) {
+  for (int i = 0; i < rb->cores; ++i) {
+    rb->half[i] = 0;
+    rb->fill[i] = 0;
+    rb->shipped[i][0] = rb->shipped[i][1] = 0;
+    rb->sent[i] = 0;
+  }
+  rb->epoch = 1;
+  rb->drained = 1;
+}
+
+/*! \brief The addresses of the given half of a destination. The values follow the addresses. */
+inline uint64_t *_REM_SLOT(RemoteBatch *rb, int dest, int half) {
+  return rb->buffer + (dest * 2 + half) * 2 * rb->cap;
+}
+
+/*! \brief Ship the half being filled of the destination, and switch to the other half. */
+inline void _REM_SHIP(RemoteBatch *rb, int dest) {
+  uint64_t n = rb->fill[dest];
+  if (n) {
+    uint64_t *slot = _REM_SLOT(rb, dest, rb->half[dest]);
+    SS_1D_READ(slot, n * DATA_WIDTH, DSA_REM_ADDR_PORT, DP_NoPadding, DMT_DMA, DATA_WIDTH);
+    SS_1D_READ(slot + rb->cap, n * DATA_WIDTH, DSA_REM_VAL_PORT, DP_NoPadding, DMT_DMA, DATA_WIDTH);
+    if (rb->scratch_type) {
+      SS_IND_REM_SCRATCH(DSA_REM_VAL_PORT, DSA_REM_ADDR_PORT, n, rb->scr_base, 1);
+    } else {
+      SS_IND_REM_SCRATCH(DSA_REM_VAL_PORT, DSA_REM_ADDR_PORT, n, rb->scr_base, 0);
+    }
+    rb->shipped[dest][rb->half[dest]] = rb->epoch++;
+    rb->sent[dest] += n;
+  }
+  rb->half[dest] ^= 1;
+  rb->fill[dest] = 0;
+  // The other half may still be read by the DMA.
+  if (rb->shipped[dest][rb->half[dest]] >= rb->drained) {
+    SS_WAIT_ALL();
+    rb->drained = rb->epoch;
+  }
+}
+
+/*!
+ * \brief Buffer a remote write. The buffered pairs of the destination are shipped once
+ *        they fill a half.
+ * \param addr The address in the shared region, which determines the destination core.
+ */
+inline void DSA_REM_PUSH(RemoteBatch *rb, uint64_t addr, uint64_t value) {
+  int dest, bank;
+  _PLAN_LOCATE(addr, rb->region, rb->cores, rb->map_type, rb->part_size, dest, bank);
+  uint64_t *slot = _REM_SLOT(rb, dest, rb->half[dest]);
+  slot[rb->fill[dest]] = addr;
+  slot[rb->cap + rb->fill[dest]] = value;
+  if (++rb->fill[dest] == rb->cap) {
+    _REM_SHIP(rb, dest);
+  }
+}
+
+/*!
+ * \brief Ship all the partially filled batches, and publish the number of writes
+ *        each destination should expect.
+ */
+inline void DSA_REM_FLUSH(RemoteBatch *rb, RemoteCounts *counts) {
+  for (int i = 0; i < rb->cores; ++i) {
+    if (rb->fill[i]) {
+      _REM_SHIP(rb, i);
+    }
+    if (rb->sent[i]) {
+      counts->incoming[i].fetch_add(rb->sent[i], std::memory_order_relaxed);
+      rb->sent[i] = 0;
+    }
+  }
+}
+
+/*!
+ * \brief Wait for all the remote writes to this core to land in the scratchpad.
+ *        It should be called after all the cores flush, e.g. in the next phase of the runtime.
+ */
+inline void DSA_REM_WAIT_DF(RemoteBatch *rb, RemoteCounts *counts) {
+  uint64_t n = counts->incoming[rb->self].exchange(0, std::memory_order_relaxed);
+  if (rb->scratch_type) {
+    SS_WAIT_DF(n, 1);
+  } else {
+    SS_WAIT_DF(n, 0);
+  }
+}
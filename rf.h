@@ -40,14 +40,14 @@ const int64_t REG_STICKY[] = {
 0, // BR
 0, // BSR
 0, // OFL
-0, // VSR
-0, // RPT
-0, // ERPT
-0, // EPRD
-0, // RESERVED0
-0, // RESERVED1
-0, // RESERVED2
-0, // RESERVED3
+0, // JNP
+0, // ICF
+0, // IRB
+0, // QOS
+0, // RESERVED4
+0, // RESERVED5
+0, // RESERVED6
+0, // RESERVED7
 0, // TOTAL_REG
 };
 
@@ -77,14 +77,14 @@ const int REG_DEFAULT[] = {
 -1, // BR
 0, // BSR
 0, // OFL
-0, // VSR
-0, // RPT
-0, // ERPT
-0, // EPRD
-0, // RESERVED0
-0, // RESERVED1
-0, // RESERVED2
-0, // RESERVED3
+0, // JNP
+0, // ICF
+0, // IRB
+0, // QOS
+0, // RESERVED4
+0, // RESERVED5
+0, // RESERVED6
+0, // RESERVED7
 0, // TOTAL_REG
 };
 
@@ -96,6 +96,13 @@ enum Padding {
   DP_Post2DStreamPredOff,	// Pad at the end of 2D stream with invalid value
   DP_PostStrideZero,		// Pad at the end of 1D stream with zero
   DP_PostStridePredOff,		// Pad at the end of 1D stream with invalid value
+  DP_PostSentinel,		// Forward the sentinel terminating the (1D) stream to the port
+};
+
+enum StreamTermination {
+  DST_Length,          // The stream ends after the given length
+  DST_SentinelStream,  // The stream ends at the first sentinel, or the given length
+  DST_Sentinel1D,      // Each 1D stream ends at the first sentinel, or the given l1d
 };
 
 enum BarrierFlag {
@@ -119,11 +126,35 @@ enum MemoryOperation {
   DMO_Unkown,
 };
 
+enum JoinMode {
+  DJM_None,
+  DJM_Intersect,  // Emit the indices in both lists
+  DJM_Union,      // Emit the indices in either list
+};
+
+enum IndexFormat {
+  DIF_Plain,        // Full-width indices
+  DIF_DeltaPacked,  // Blocks of a base index and bit-packed zigzag deltas
+  DIF_RunLength,    // Runs of consecutive indices, each encoded as a (start, length) word
+};
+
 enum StreamAction {
   DSA_Access,
   DSA_Generate
 };
 
+enum StreamPriority {
+  DSP_Normal,    // Share the memory requests equally with the other streams
+  DSP_Bulk,      // Background traffic, which yields to the other streams
+  DSP_Critical,  // Latency critical, which preempts the others in the request arbiter
+};
+
+enum LaneTransfer {
+  DLT_Local,  // Forward the output port to the input port of the same lane
+  DLT_Left,   // Forward to the input port of the left lane on the ring
+  DLT_Right,  // Forward to the input port of the right lane on the ring
+};
+
 enum PortField {
   DPF_PortBroadcast,
   DPF_PortRepeat,
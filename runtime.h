@@ -0,0 +1,299 @@
+/*!
+ * \file runtime.h
+ * \author PolyArch Research Lab
+ * \brief A host runtime that runs a kernel across all the accelerator-equipped harts.
+ *        Each hart owns a thread and the DSA context of its core. Tiles of a phase are
+ *        distributed by work stealing, and phases are separated by SS_GLOBAL_WAIT, after
+ *        each hart drains its accelerator by SS_WAIT_ALL.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <pthread.h>
+#include <sched.h>
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief A task of the runtime.
+ * \param arg The argument given when launching the phase.
+ * \param tile The index of the tile to run.
+ * \param tid The hart running this tile.
+ */
+typedef void (*DSATileFunc)(void *arg, int64_t tile, int tid);
+
+/*!
+ * \brief The per-hart state. The range of unclaimed tiles [lo, hi) is packed in 64 bits,
+ *        so that the owner and the thieves claim tiles by a single CAS.
+ *        It is aligned to a memory line to avoid false sharing.
+ */
+struct alignas(MEM_WIDTH) DSAHartState {
+  std::atomic<uint64_t> range{0};
+  pthread_t thread;
+};
+
+struct DSARuntime {
+  /*!
+   * \brief The number of harts, including the one calling DSA_RT_INIT.
+   */
+  int num_threads;
+  /*!
+   * \brief The lanes of each hart the commands are broadcast to. Refer SS_CONTEXT.
+   */
+  uint64_t lanes;
+  /*!
+   * \brief The bitstream of the spatial architecture configuration loaded by each hart.
+   */
+  REG config;
+  REG config_size;
+  /*!
+   * \brief The task of the ongoing phase.
+   */
+  DSATileFunc func;
+  void *arg;
+  /*!
+   * \brief If set, each hart runs the task exactly once with its own tid as the tile.
+   */
+  bool per_hart;
+  /*!
+   * \brief Incremented to launch a phase. The workers spin on it.
+   */
+  std::atomic<int> phase{0};
+  std::atomic<bool> stop{false};
+  /*!
+   * \brief The harts arrived at the barrier ending the phase, and the barriers passed, on the
+   *        software model. Refer _RT_BARRIER.
+   */
+  std::atomic<int> arrived{0};
+  std::atomic<int> barriers{0};
+  /*!
+   * \brief The CPU each hart is pinned to, or -1 if it is not pinned.
+   */
+  int cpu[DSA_MAX_HARTS];
+  DSAHartState hart[DSA_MAX_HARTS];
+};
+
+/*! \brief Pack a tile range [lo, hi) into 64 bits, so the tiles should be fewer than 2^32. */
+inline uint64_t _RT_RANGE(uint64_t lo, uint64_t hi) {
+  assert(lo <= hi && hi <= 0xffffffffu);
+  return (hi << 32) | lo;
+}
+
+/*! \brief Claim the first unclaimed tile of the given hart. */
+inline bool _RT_POP(DSAHartState *hs, int64_t &tile) {
+  uint64_t r = hs->range.load(std::memory_order_acquire);
+  while ((r & 0xffffffffu) < (r >> 32)) {
+    if (hs->range.compare_exchange_weak(r, r + 1, std::memory_order_acq_rel)) {
+      tile = r & 0xffffffffu;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*! \brief Steal the upper half of the unclaimed tiles of the victim into the thief's range. */
+inline bool _RT_STEAL(DSAHartState *victim, DSAHartState *thief) {
+  uint64_t r = victim->range.load(std::memory_order_acquire);
+  while ((r & 0xffffffffu) < (r >> 32)) {
+    uint64_t lo = r & 0xffffffffu, hi = r >> 32;
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (victim->range.compare_exchange_weak(r, _RT_RANGE(lo, mid), std::memory_order_acq_rel)) {
+      thief->range.store(_RT_RANGE(mid, hi), std::memory_order_release);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*!
+ * \brief The barrier of all the harts on the software model, which has no SS_GLOBAL_WAIT.
+ *        The last one arriving releases the others.
+ */
+inline void _RT_BARRIER(DSARuntime *rt) {
+  int passed = rt->barriers.load(std::memory_order_acquire);
+  if (rt->arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == rt->num_threads) {
+    rt->arrived.store(0, std::memory_order_relaxed);
+    rt->barriers.fetch_add(1, std::memory_order_release);
+  } else {
+    while (rt->barriers.load(std::memory_order_acquire) == passed) {
+    }
+  }
+}
+
+/*!
+ * \brief Run the ongoing phase on the given hart. After all the tiles are claimed, wait for
+ *        the local accelerator and then all the harts.
+ */
+inline void _RT_PHASE(DSARuntime *rt, int tid) {
+  if (rt->per_hart) {
+    rt->func(rt->arg, tid, tid);
+  } else {
+    DSAHartState *self = rt->hart + tid;
+    int64_t tile;
+    for (;;) {
+      while (_RT_POP(self, tile)) {
+        rt->func(rt->arg, tile, tid);
+      }
+      bool stolen = false;
+      for (int i = 1; i < rt->num_threads && !stolen; ++i) {
+        stolen = _RT_STEAL(rt->hart + (tid + i) % rt->num_threads, self);
+      }
+      if (!stolen) {
+        break;
+      }
+    }
+  }
+  SS_WAIT_ALL();
+#ifdef DSA_SOFT_MODEL
+  _RT_BARRIER(rt);
+#else
+  SS_GLOBAL_WAIT((uint64_t) rt->num_threads);
+#endif
+}
+
+/*! \brief Pin the calling hart to its CPU, if any. */
+inline void _RT_PIN(DSARuntime *rt, int tid) {
+#ifdef __linux__
+  if (rt->cpu[tid] >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(rt->cpu[tid], &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+#else
+  (void) rt;
+  (void) tid;
+#endif
+}
+
+/*! \brief Set up the DSA context of the calling hart. */
+inline void _RT_CONTEXT(DSARuntime *rt) {
+  SS_CONTEXT(rt->lanes);
+  if (rt->config_size) {
+    SS_CONFIG(rt->config, rt->config_size);
+  }
+}
+
+struct _RTWorkerArg {
+  DSARuntime *rt;
+  int tid;
+};
+
+/*! \brief The main loop of a worker hart. */
+inline void *_RT_WORKER(void *raw) {
+  DSARuntime *rt = ((_RTWorkerArg*) raw)->rt;
+  int tid = ((_RTWorkerArg*) raw)->tid;
+  delete (_RTWorkerArg*) raw;
+  _RT_PIN(rt, tid);
+  _RT_CONTEXT(rt);
+  int seen = 0;
+  for (;;) {
+    int cur;
+    while ((cur = rt->phase.load(std::memory_order_acquire)) == seen) {
+    }
+    seen = cur;
+    if (rt->stop.load(std::memory_order_acquire)) {
+      break;
+    }
+    _RT_PHASE(rt, tid);
+  }
+  return nullptr;
+}
+
+/*!
+ * \brief Launch the workers. The calling hart joins the runtime as hart 0.
+ * \param num_threads The number of harts, at least 1 and at most DSA_MAX_HARTS.
+ * \param config The bitstream of the spatial architecture loaded by each hart.
+ * \param size The size of the bitstream in bytes. If 0, the configuration is left as it is.
+ * \param lanes The lanes each hart broadcasts its commands to.
+ * \param cpus The CPU each hart is pinned to, i.e. the core of its accelerator, or -1 to leave
+ *             it unpinned. By default, hart i is pinned to CPU i, and the calling hart is left
+ *             where it runs, which assumes that hart i is on CPU i.
+ */
+inline void DSA_RT_INIT(DSARuntime *rt, int num_threads, REG config, REG size, uint64_t lanes,
+                        const int *cpus = nullptr) {
+  assert(num_threads >= 1);
+  rt->num_threads = num_threads < DSA_MAX_HARTS ? num_threads : DSA_MAX_HARTS;
+  rt->lanes = lanes;
+  rt->config = config;
+  rt->config_size = size;
+  rt->phase.store(0);
+  rt->stop.store(false);
+  rt->arrived.store(0);
+  rt->barriers.store(0);
+  for (int i = 0; i < rt->num_threads; ++i) {
+    rt->cpu[i] = cpus ? cpus[i] : (i ? i : -1);
+  }
+  _RT_PIN(rt, 0);
+  _RT_CONTEXT(rt);
+  for (int i = 1; i < rt->num_threads; ++i) {
+    pthread_create(&rt->hart[i].thread, nullptr, _RT_WORKER, new _RTWorkerArg{rt, i});
+  }
+}
+
+/*! \brief Run a phase on all the harts, and return after all the harts pass the barrier. */
+inline void _RT_LAUNCH(DSARuntime *rt, DSATileFunc func, void *arg, bool per_hart) {
+  rt->func = func;
+  rt->arg = arg;
+  rt->per_hart = per_hart;
+  rt->phase.fetch_add(1, std::memory_order_release);
+  _RT_PHASE(rt, 0);
+}
+
+/*!
+ * \brief Run n tiles across all the harts. Each hart starts from an even share of contiguous
+ *        tiles, so that neighboring tiles tend to stay on the same core, and steals half of
+ *        a busy hart's remaining tiles when it runs out.
+ */
+inline void DSA_RT_FOR(DSARuntime *rt, int64_t n, DSATileFunc func, void *arg) {
+  assert(n >= 0 && n <= 0xffffffffll);
+  for (int i = 0; i < rt->num_threads; ++i) {
+    rt->hart[i].range.store(_RT_RANGE(n * i / rt->num_threads, n * (i + 1) / rt->num_threads),
+                            std::memory_order_relaxed);
+  }
+  _RT_LAUNCH(rt, func, arg, false);
+}
+
+/*! \brief Run the function exactly once on each hart, with its tid as the tile. */
+inline void DSA_RT_EACH_HART(DSARuntime *rt, DSATileFunc func, void *arg) {
+  _RT_LAUNCH(rt, func, arg, true);
+}
+
+/*! \brief The bitmask of the cores in the runtime. */
+inline uint64_t DSA_RT_CORES(DSARuntime *rt) {
+  return rt->num_threads >= 64 ? ~0ull : (1ull << rt->num_threads) - 1;
+}
+
+struct _RTMemMap {
+  uint64_t part_size;
+  uint64_t cores;
+  int map_type;
+};
+
+/*! \brief Apply the memory map on the calling hart. */
+inline void _RT_MEM_MAP(void *raw, int64_t, int) {
+  _RTMemMap *mm = (_RTMemMap*) raw;
+  SS_MEM_MAP(mm->part_size, mm->cores, mm->map_type);
+}
+
+/*!
+ * \brief Lay out the shared scratchpad data across the cores of the runtime.
+ * \param part_size The size of each partition in bytes.
+ * \param map_type One of PART_CORE_BANK_REST, PART_CORE_REST_BANK, and CORE_PART_BANK_REST.
+ */
+inline void DSA_RT_MEM_MAP(DSARuntime *rt, uint64_t part_size, int map_type) {
+  _RTMemMap mm{part_size, DSA_RT_CORES(rt), map_type};
+  DSA_RT_EACH_HART(rt, _RT_MEM_MAP, &mm);
+}
+
+/*! \brief Terminate and join the workers. */
+inline void DSA_RT_FINI(DSARuntime *rt) {
+  rt->stop.store(true, std::memory_order_release);
+  rt->phase.fetch_add(1, std::memory_order_release);
+  for (int i = 1; i < rt->num_threads; ++i) {
+    pthread_join(rt->hart[i].thread, nullptr);
+  }
+}
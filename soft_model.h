@@ -0,0 +1,231 @@
+/*!
+ * \file soft_model.h
+ * \author PolyArch Research Lab
+ * \brief A software timing model of the accelerator, for tuning and benchmarking on a host
+ *        without the hardware. When DSA_SOFT_MODEL is defined, dsaintrin.h routes the
+ *        intrinsics to this model instead of emitting the instructions.
+ *        The model is not functional: it only keeps the register file, and estimates the
+ *        cycles of each epoch between two barriers as the most loaded resource among the
+ *        host issue, the memory, the scratchpad, and the ports, plus the memory latency.
+ *        The legacy macros emitting raw instructions are not modeled.
+ * \note This is included by dsaintrin.h. Do not include it directly.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include <string.h>
+#include <algorithm>
+
+/*!
+ * \brief The cycles of the host to issue an instruction to the accelerator.
+ */
+#ifndef DSA_MODEL_INST_CYCLES
+#define DSA_MODEL_INST_CYCLES 1
+#endif
+
+/*!
+ * \brief The latency exposed by an epoch accessing the memory.
+ */
+#ifndef DSA_MODEL_MEM_LATENCY
+#define DSA_MODEL_MEM_LATENCY 100
+#endif
+
+/*!
+ * \brief The statistics of the model.
+ */
+struct DSAModelStats {
+  /*!
+   * \brief The instructions issued to the accelerator, and the streams among them.
+   */
+  uint64_t insts, streams;
+  /*!
+   * \brief The bytes moved by the memory, the scratchpad, and all the ports.
+   */
+  uint64_t dma_bytes, spad_bytes, port_bytes;
+  /*!
+   * \brief The highest scratchpad address accessed.
+   */
+  uint64_t spad_high;
+  /*!
+   * \brief The barriers, and the estimated cycles.
+   */
+  uint64_t epochs;
+  double cycles;
+};
+
+struct DSAModel {
+  uint64_t rf[DSARF::TOTAL_REG];
+  bool sticky[DSARF::TOTAL_REG];
+  /*!
+   * \brief The repeat of the next stream of each port.
+   */
+  uint64_t repeat[DSA_MAX_PORTS];
+  /*!
+   * \brief The load of each resource in the ongoing epoch.
+   */
+  uint64_t insts, dma, spad, port[DSA_MAX_PORTS];
+  DSAModelStats stats;
+};
+
+inline DSAModel _dsa_model;
+
+/*! \brief Reset the model, including the statistics. */
+inline void DSA_MODEL_RESET() {
+  memset(&_dsa_model, 0, sizeof(_dsa_model));
+  for (int i = 0; i < DSARF::TOTAL_REG; ++i) {
+    _dsa_model.rf[i] = REG_DEFAULT[i];
+    _dsa_model.sticky[i] = REG_STICKY[i];
+  }
+  _dsa_model.rf[DSARF::TBC] = 1;
+}
+
+/*! \brief Close the ongoing epoch, and account its cycles. */
+inline void _MODEL_EPOCH() {
+  DSAModel &m = _dsa_model;
+  double t = (double) m.insts * DSA_MODEL_INST_CYCLES;
+  t = std::max(t, (double) m.dma / MEM_WIDTH);
+  t = std::max(t, (double) m.spad / SCR_WIDTH);
+  for (int i = 0; i < DSA_MAX_PORTS; ++i) {
+    t = std::max(t, (double) m.port[i] / PORT_WIDTH);
+    m.port[i] = 0;
+  }
+  if (m.dma) {
+    t += DSA_MODEL_MEM_LATENCY;
+  }
+  m.stats.cycles += t;
+  ++m.stats.epochs;
+  m.insts = m.dma = m.spad = 0;
+}
+
+/*! \brief The statistics so far, with the ongoing epoch closed. */
+inline DSAModelStats DSA_MODEL_STATS() {
+  _MODEL_EPOCH();
+  return _dsa_model.stats;
+}
+
+/*! \brief The number of lanes in the context. */
+inline uint64_t _MODEL_LANES() {
+  return std::max(__builtin_popcountll(_dsa_model.rf[DSARF::TBC]), 1);
+}
+
+/*! \brief Account a stream of n elements of dtype bytes on the port and the memory. */
+inline void _MODEL_STREAM(int port, int memory, bool access, uint64_t n, int dtype,
+                          uint64_t mem_bytes, uint64_t high) {
+  DSAModel &m = _dsa_model;
+  uint64_t lanes = _MODEL_LANES();
+  port &= DSA_MAX_PORTS - 1;
+  uint64_t repeat = m.repeat[port] ? m.repeat[port] >> DSA_REPEAT_DIGITAL_POINT : 1;
+  m.repeat[port] = 0;
+  m.port[port] += n * dtype * (repeat ? repeat : 1);
+  m.stats.port_bytes += n * dtype * lanes;
+  if (access) {
+    if (memory == DMT_SPAD) {
+      m.spad += mem_bytes;
+      m.stats.spad_bytes += mem_bytes * lanes;
+      m.stats.spad_high = std::max(m.stats.spad_high, high);
+    } else {
+      // The memory is shared by all the lanes.
+      m.dma += mem_bytes * lanes;
+      m.stats.dma_bytes += mem_bytes * lanes;
+    }
+  }
+  ++m.stats.streams;
+  for (int i = 0; i < DSARF::TOTAL_REG; ++i) {
+    if (!m.sticky[i]) {
+      m.rf[i] = REG_DEFAULT[i];
+    }
+  }
+}
+
+/*! \brief The number of elements of the linear stream in the register file. */
+inline uint64_t _MODEL_LINEAR_ELEMS(int dim) {
+  const uint64_t *rf = _dsa_model.rf;
+  if (dim == 0) {
+    return rf[DSARF::L1D];
+  }
+  int64_t res = 0;
+  int64_t n3d = dim == 2 ? rf[DSARF::L3D] : 1;
+  for (int64_t i = 0; i < n3d; ++i) {
+    int64_t l1d = rf[DSARF::L1D] + i * (int64_t) rf[DSARF::E3D1D];
+    int64_t n2d = rf[DSARF::L2D] + i * (int64_t) rf[DSARF::E3D2D];
+    int64_t e2d = rf[DSARF::E2D] + i * (int64_t) rf[DSARF::DE2D];
+    res += n2d * l1d + e2d * n2d * (n2d - 1) / 2;
+  }
+  return res;
+}
+
+/*!
+ * \brief The end of the bytes accessed by the linear stream in the register file, where the
+ *        extent of each dimension is from its first length and stride.
+ */
+inline uint64_t _MODEL_LINEAR_HIGH(int dim, int dtype) {
+  const uint64_t *rf = _dsa_model.rf;
+  int64_t high = rf[DSARF::L1D] ? (rf[DSARF::L1D] - 1) * (int64_t) rf[DSARF::I1D] : 0;
+  if (dim >= 1 && rf[DSARF::L2D]) {
+    high += std::max((int64_t) (rf[DSARF::L2D] - 1) * (int64_t) rf[DSARF::I2D], (int64_t) 0);
+  }
+  if (dim == 2 && rf[DSARF::L3D]) {
+    high += std::max((int64_t) (rf[DSARF::L3D] - 1) * (int64_t) rf[DSARF::I3D], (int64_t) 0);
+  }
+  return rf[DSARF::SAR] + (std::max(high, (int64_t) 0) + 1) * dtype;
+}
+
+/*! \brief Execute an instruction in the model. */
+inline uint64_t _DSA_MODEL(const char *mn, uint64_t a, uint64_t b, uint64_t c) {
+  DSAModel &m = _dsa_model;
+  ++m.insts;
+  ++m.stats.insts;
+  int dtype = 1 << (m.rf[DSARF::CSR] & 3);
+  if (!strcmp(mn, "ss_cfg_param")) {
+    int idx1 = c & 31, idx2 = (c >> 5) & 31;
+    if (idx1) {
+      m.rf[idx1] = a;
+      m.sticky[idx1] = (c >> 10) & 1;
+    }
+    if (idx2) {
+      m.rf[idx2] = b;
+      m.sticky[idx2] = (c >> 11) & 1;
+    }
+  } else if (!strcmp(mn, "ss_cfg_port")) {
+    if ((c & 15) == DPF_PortRepeat) {
+      m.repeat[(c >> 5) & (DSA_MAX_PORTS - 1)] = a;
+    }
+  } else if (!strcmp(mn, "ss_lin_strm")) {
+    int dim = (a >> 15) & 3;
+    bool access = !((a >> 14) & 1);
+    if (!access) {
+      // A generated stream is of the const data type.
+      dtype = 1 << ((m.rf[DSARF::CSR] >> 2) & 3);
+    }
+    // A prefetch touches the memory, but delivers nothing to the port.
+    bool prefetch = (a >> 19) & 1;
+    uint64_t n = _MODEL_LINEAR_ELEMS(dim);
+    uint64_t high = _MODEL_LINEAR_HIGH(dim, dtype);
+    if (m.rf[DSARF::BR] != (uint64_t) REG_DEFAULT[DSARF::BR]) {
+      // The addresses of a buffet wrap around its range.
+      high = std::min(high, m.rf[DSARF::BR] >> 32);
+    }
+    _MODEL_STREAM(a & 127, (a >> 10) & 1, access, prefetch ? 0 : n, dtype, n * dtype, high);
+  } else if (!strcmp(mn, "ss_ind_strm")) {
+    int dim = (a >> 15) & 1;
+    int join = (a >> 17) & 3;
+    uint64_t n = m.rf[DSARF::L1D] * (dim ? std::max(m.rf[DSARF::L2D], (uint64_t) 1) : 1);
+    if (join) {
+      n = m.rf[DSARF::L1D] + m.rf[DSARF::IL1D];
+    }
+    int memory = (a >> 10) & 1;
+    // A random access of the memory costs a whole line.
+    uint64_t bytes = n * (memory == DMT_SPAD ? dtype : MEM_WIDTH);
+    _MODEL_STREAM(a & 127, memory, true, (a >> 21) & 1 ? 0 : n, dtype, bytes, 0);
+  } else if (!strcmp(mn, "ss_wr_rd")) {
+    // A transfer to the adjacent lane, bits 14-15, costs the same as a recurrence.
+    _MODEL_STREAM(a & 127, DMT_DMA, false, m.rf[DSARF::L1D], dtype, 0, 0);
+  } else if (!strcmp(mn, "ss_wait") || !strcmp(mn, "ss_recv")) {
+    _MODEL_EPOCH();
+  } else if (!strcmp(mn, "ss_stat")) {
+    _MODEL_EPOCH();
+    return 1;
+  }
+  return 0;
+}
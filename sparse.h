@@ -0,0 +1,254 @@
+/*!
+ * \file sparse.h
+ * \author PolyArch Research Lab
+ * \brief Sparse kernels (SpMV, SpMM, and SDDMM) driving Indirect2DAttr.
+ *        Each kernel issues all the streams of the whole matrix at once. The spatial
+ *        configuration of each kernel is expected to follow the port contract documented
+ *        below, and the ports should be compile-time constants.
+ *        An indirect stream without the idx port uses index 0 for each element, i.e. repeats
+ *        the element at its start, so a contiguous row is gathered by the idx port of 0..k-1.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief A compressed sparse matrix. For CSR, ptr has rows+1 entries and idx holds the
+ *        column indices; for CSC, ptr has cols+1 entries and idx holds the row indices.
+ */
+struct SparseMatrix {
+  uint64_t rows, cols, nnz;
+  REG ptr;
+  int ptr_dtype{4};
+  REG idx;
+  int idx_dtype{4};
+  REG val;
+  int dtype{8};
+};
+
+/*!
+ * \brief The ports of the sparse kernels.
+ *        The in_* and out_* ports belong to the spatial configuration. The ind_* ports feed the
+ *        indirect stream engine directly, and are the indirect ports by default.
+ */
+struct SparsePorts {
+  /*!
+   * \brief ptr[i] and ptr[i+1]. The configuration derives the length of each row (column),
+   *        which drives the per-row reduction.
+   */
+  int in_ptr_lo, in_ptr_hi;
+  /*!
+   * \brief The nonzero values.
+   */
+  int in_val;
+  /*!
+   * \brief The gathered dense operands.
+   */
+  int in_gather, in_gather2;
+  /*!
+   * \brief The indices of the nonzeros to be scaled into row offsets. Only used by SpMM/SDDMM.
+   */
+  int in_idx;
+  /*!
+   * \brief The derived lengths fed back to ind_l1d.
+   */
+  int out_len;
+  /*!
+   * \brief The scaled row offsets fed back to ind_start.
+   */
+  int out_start;
+  /*!
+   * \brief The results.
+   */
+  int out;
+  int ind_idx{P_IND_1}, ind_l1d{P_IND_2}, ind_start{P_IND_3};
+  int ind_idx2{P_IND_4}, ind_start2{P_IND_5};
+};
+
+/*! \brief Generate the affine sequence start, start+stride, ... of n elements to a port. */
+DSA_INLINE void _SPARSE_SEQ(int port, REG start, REG stride, REG n, int ctype) {
+  INSTANTIATE_1D_STREAM(start, stride, n, port, DP_NoPadding, DSA_Generate,
+                        DMO_Read, DMT_DMA, 1, ctype);
+}
+
+/*! \brief Generate the sequence 0..k-1, n times, to a port. */
+DSA_INLINE void _SPARSE_SEQ_2D(int port, REG k, REG n, int ctype) {
+  INSTANTIATE_2D_STREAM((uint64_t) 0, (uint64_t) 1, k, (uint64_t) 0, (uint64_t) 0, n,
+                        port, DP_NoPadding, DSA_Generate, DMO_Read, DMT_DMA, 1, ctype);
+}
+
+/*! \brief Feed ptr[0:n] and ptr[1:n+1] to the configuration to derive the lengths. */
+DSA_INLINE void _SPARSE_PTR(const SparseMatrix *a, uint64_t n, const SparsePorts *p) {
+  uint64_t bytes = n * a->ptr_dtype;
+  SS_1D_READ(a->ptr, bytes, p->in_ptr_lo, DP_NoPadding, DMT_DMA, a->ptr_dtype);
+  SS_1D_READ(a->ptr.value + a->ptr_dtype, bytes, p->in_ptr_hi, DP_NoPadding, DMT_DMA, a->ptr_dtype);
+}
+
+/*!
+ * \brief y = A x, where A is in CSR.
+ * \code{c}
+ *   for (i=0; i<rows; ++i)
+ *     for (k=ptr[i]; k<ptr[i+1]; ++k)
+ *       y[i] += val[k] * x[idx[k]]
+ * \endcode
+ *        Configuration: out_len = in_ptr_hi - in_ptr_lo;
+ *                       out = sum of out_len products of in_val * in_gather.
+ *        The row pointers drive the l1d port, the column indices drive the idx port,
+ *        and the values are read linearly.
+ */
+DSA_INLINE void SS_SPMV_CSR(const SparseMatrix *a, REG x, REG y, const SparsePorts *p,
+                            bool penetrate = false, bool associate = false) {
+  _SPARSE_PTR(a, a->rows, p);
+  SS_RECURRENCE(p->out_len, p->ind_l1d, a->rows, a->ptr_dtype);
+  SS_1D_READ(a->idx, a->nnz * a->idx_dtype, p->ind_idx, DP_NoPadding, DMT_DMA, a->idx_dtype);
+  Indirect2DAttr i2a;
+  i2a.dest_port = p->in_gather;
+  i2a.dtype = a->dtype;
+  i2a.start = x;
+  i2a.idx_port = p->ind_idx;
+  i2a.idx_dtype = a->idx_dtype;
+  i2a.l1d_port = p->ind_l1d;
+  i2a.l1d_dtype = a->ptr_dtype;
+  i2a.l1d = (uint64_t) 0;
+  i2a.l2d = a->rows;
+  i2a.memory = DMT_DMA;
+  i2a.penetrate = penetrate;
+  i2a.associate = associate;
+  SS_INDIRECT_2D_READ(&i2a);
+  SS_1D_READ(a->val, a->nnz * a->dtype, p->in_val, DP_NoPadding, DMT_DMA, a->dtype);
+  SS_1D_WRITE(p->out, y, a->rows * a->dtype, DMT_DMA, a->dtype);
+}
+
+/*!
+ * \brief y += A x, where A is in CSC. y should be in the scratchpad for the atomic updates.
+ * \code{c}
+ *   for (j=0; j<cols; ++j)
+ *     for (k=ptr[j]; k<ptr[j+1]; ++k)
+ *       y[idx[k]] += val[k] * x[j]
+ * \endcode
+ *        Configuration: out_len = in_ptr_hi - in_ptr_lo; out = in_val * in_gather.
+ *        x[j] is gathered ptr[j+1]-ptr[j] times by an indirect stream without the idx port,
+ *        whose start port is the sequence of column numbers.
+ */
+DSA_INLINE void SS_SPMV_CSC(const SparseMatrix *a, REG x, REG y, const SparsePorts *p,
+                            bool penetrate = false, bool associate = false) {
+  _SPARSE_PTR(a, a->cols, p);
+  SS_RECURRENCE(p->out_len, p->ind_l1d, a->cols, a->ptr_dtype);
+  _SPARSE_SEQ(p->ind_start, (uint64_t) 0, (uint64_t) 1, a->cols, a->idx_dtype);
+  Indirect2DAttr i2a;
+  i2a.dest_port = p->in_gather;
+  i2a.dtype = a->dtype;
+  i2a.start_port = p->ind_start;
+  i2a.start_dtype = a->idx_dtype;
+  i2a.start = x;
+  i2a.l1d_port = p->ind_l1d;
+  i2a.l1d_dtype = a->ptr_dtype;
+  i2a.l1d = (uint64_t) 0;
+  i2a.l2d = a->cols;
+  i2a.memory = DMT_DMA;
+  i2a.penetrate = penetrate;
+  i2a.associate = associate;
+  SS_INDIRECT_2D_READ(&i2a);
+  SS_1D_READ(a->val, a->nnz * a->dtype, p->in_val, DP_NoPadding, DMT_DMA, a->dtype);
+  SS_1D_READ(a->idx, a->nnz * a->idx_dtype, p->ind_idx, DP_NoPadding, DMT_DMA, a->idx_dtype);
+  SS_INDIRECT_ATOMIC(p->out, a->dtype, p->ind_idx, a->idx_dtype, y, 1, a->nnz, DMT_SPAD, DMO_Add);
+}
+
+/*!
+ * \brief C = A B, where A is in CSR, and B (cols x k) and C (rows x k) are dense row-major.
+ * \code{c}
+ *   for (i=0; i<rows; ++i)
+ *     for (e=ptr[i]; e<ptr[i+1]; ++e)
+ *       C[i,:] += val[e] * B[idx[e],:]
+ * \endcode
+ *        Configuration: out_start = in_idx * k; the row length in_ptr_hi - in_ptr_lo
+ *                       controls the reduction of out = sum of in_val * in_gather,
+ *                       k-element vectors each.
+ *        Each nonzero gathers a row of B by an indirect stream, whose start port is the
+ *        scaled column index, and whose idx port is the sequence 0..k-1 per nonzero.
+ */
+DSA_INLINE void SS_SPMM_CSR(const SparseMatrix *a, REG b, uint64_t k, REG c,
+                            const SparsePorts *p, bool penetrate = false, bool associate = false) {
+  _SPARSE_PTR(a, a->rows, p);
+  SS_1D_READ(a->idx, a->nnz * a->idx_dtype, p->in_idx, DP_NoPadding, DMT_DMA, a->idx_dtype);
+  SS_RECURRENCE(p->out_start, p->ind_start, a->nnz, a->idx_dtype);
+  _SPARSE_SEQ_2D(p->ind_idx, k, a->nnz, a->idx_dtype);
+  Indirect2DAttr i2a;
+  i2a.dest_port = p->in_gather;
+  i2a.dtype = a->dtype;
+  i2a.start_port = p->ind_start;
+  i2a.start_dtype = a->idx_dtype;
+  i2a.start = b;
+  i2a.idx_port = p->ind_idx;
+  i2a.idx_dtype = a->idx_dtype;
+  i2a.l1d = k;
+  i2a.l2d = a->nnz;
+  i2a.memory = DMT_DMA;
+  i2a.penetrate = penetrate;
+  i2a.associate = associate;
+  SS_INDIRECT_2D_READ(&i2a);
+  SS_REPEAT_PORT(p->in_val, k);
+  SS_1D_READ(a->val, a->nnz * a->dtype, p->in_val, DP_NoPadding, DMT_DMA, a->dtype);
+  SS_1D_WRITE(p->out, c, a->rows * k * a->dtype, DMT_DMA, a->dtype);
+}
+
+/*!
+ * \brief out = S .* (A B^T), where S is in CSR, and A (rows x k) and B (cols x k) are
+ *        dense row-major. out holds one value per nonzero of S.
+ * \code{c}
+ *   for (i=0; i<rows; ++i)
+ *     for (e=ptr[i]; e<ptr[i+1]; ++e)
+ *       out[e] = val[e] * dot(A[i,:], B[idx[e],:])
+ * \endcode
+ *        Configuration: out_len = (in_ptr_hi - in_ptr_lo) * k; out_start = in_idx * k;
+ *                       out = in_val * (k-element dot product of in_gather and in_gather2).
+ *        A[i,:] is gathered once per nonzero of row i, by the start port of row offsets i*k,
+ *        the l1d port of the derived lengths, and the idx port of 0..k-1 per nonzero.
+ *        B[idx[e],:] is gathered by the scaled column indices as in SpMM, by the other idx
+ *        port of 0..k-1 per nonzero.
+ */
+DSA_INLINE void SS_SDDMM_CSR(const SparseMatrix *a, REG dense_a, REG dense_b, uint64_t k,
+                             REG out, const SparsePorts *p,
+                             bool penetrate = false, bool associate = false) {
+  _SPARSE_PTR(a, a->rows, p);
+  SS_RECURRENCE(p->out_len, p->ind_l1d, a->rows, a->ptr_dtype);
+  _SPARSE_SEQ(p->ind_start, (uint64_t) 0, k, a->rows, a->idx_dtype);
+  _SPARSE_SEQ_2D(p->ind_idx, k, a->nnz, a->idx_dtype);
+  Indirect2DAttr rows;
+  rows.dest_port = p->in_gather;
+  rows.dtype = a->dtype;
+  rows.start_port = p->ind_start;
+  rows.start_dtype = a->idx_dtype;
+  rows.start = dense_a;
+  rows.idx_port = p->ind_idx;
+  rows.idx_dtype = a->idx_dtype;
+  rows.l1d_port = p->ind_l1d;
+  rows.l1d_dtype = a->ptr_dtype;
+  rows.l1d = (uint64_t) 0;
+  rows.l2d = a->rows;
+  rows.memory = DMT_DMA;
+  rows.penetrate = penetrate;
+  rows.associate = associate;
+  SS_INDIRECT_2D_READ(&rows);
+  SS_1D_READ(a->idx, a->nnz * a->idx_dtype, p->in_idx, DP_NoPadding, DMT_DMA, a->idx_dtype);
+  SS_RECURRENCE(p->out_start, p->ind_start2, a->nnz, a->idx_dtype);
+  _SPARSE_SEQ_2D(p->ind_idx2, k, a->nnz, a->idx_dtype);
+  Indirect2DAttr cols;
+  cols.dest_port = p->in_gather2;
+  cols.dtype = a->dtype;
+  cols.start_port = p->ind_start2;
+  cols.start_dtype = a->idx_dtype;
+  cols.start = dense_b;
+  cols.idx_port = p->ind_idx2;
+  cols.idx_dtype = a->idx_dtype;
+  cols.l1d = k;
+  cols.l2d = a->nnz;
+  cols.memory = DMT_DMA;
+  cols.penetrate = penetrate;
+  cols.associate = associate;
+  SS_INDIRECT_2D_READ(&cols);
+  SS_1D_READ(a->val, a->nnz * a->dtype, p->in_val, DP_NoPadding, DMT_DMA, a->dtype);
+  SS_1D_WRITE(p->out, out, a->nnz * a->dtype, DMT_DMA, a->dtype);
+}
@@ -67,6 +67,13 @@
 #define DSA_REPEAT_DIGITAL_POINT 4
 #endif
 
+/*!
+ * \brief The max number of accelerator-equipped host cores (harts) on a chip.
+ */
+#ifndef DSA_MAX_HARTS
+#define DSA_MAX_HARTS 64
+#endif
+
 /// {
 
 typedef uint64_t addr_t;
@@ -75,12 +82,15 @@ typedef uint64_t addr_t;
 #define SSWORD uint8_t          //dgra datatype
 #define DATA_WIDTH sizeof(SBDT)
 // #define SCRATCH_SIZE (16384) //size in bytes -- 16KB
+#ifndef SCRATCH_SIZE
 #define SCRATCH_SIZE (1048576) //size in bytes -- 1MB
+#endif
 #define SPU_NET_PACKET_SIZE 64
+#ifndef NUM_SCRATCH_BANKS
 #define NUM_SCRATCH_BANKS 64
+#endif
 
 #define LSCRATCH_SIZE (1 << 20) //size in bytes -- 16KB
-#define NUM_SCRATCH_BANKS 64
 #define MAX_BANK_BUFFER_SIZE 64 // 8
 // #define NUM_SPU_CORES 64 // for global address space
 
@@ -92,13 +102,19 @@ typedef uint64_t addr_t;
 
 #define SD_TRANSFERS_ALLOWED 22
 
+#ifndef MEM_WIDTH
 #define MEM_WIDTH (64)
+#endif
 #define MEM_MASK ~(MEM_WIDTH-1)
 
+#ifndef SCR_WIDTH
 #define SCR_WIDTH (64)
+#endif
 #define SCR_MASK ~(SCR_WIDTH-1)
 
+#ifndef PORT_WIDTH
 #define PORT_WIDTH (64)
+#endif
 #define VP_LEN (64)
 
 #define MAX_MEM_REQS (100)
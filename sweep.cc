@@ -0,0 +1,154 @@
+/*!
+ * \file sweep.cc
+ * \author PolyArch Research Lab
+ * \brief The kernel set of the design-space sweep. It runs each kernel once on the software
+ *        model, with the spec.h of the compiler flags, and appends a record of JSON per kernel
+ *        to the output, with:
+ *        bytes_per_cycle: the bytes of the payload of the kernel per cycle.
+ *        spad_occupancy: the scratchpad used, spad_high, out of SCRATCH_SIZE.
+ *        ctrl_ratio: the cycles of the host issuing the instructions out of the cycles.
+ *        It is built and run for each variant by sweep.py. The model only reflects MEM_WIDTH,
+ *        SCR_WIDTH, PORT_WIDTH, and SCRATCH_SIZE of spec.h, not the lanes or the ports.
+ *        Usage: sweep [results.jsonl]
+ * \copyright Copyright (c) 2020
+ */
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "conv.h"
+#include "gemm.h"
+#include "reduce.h"
+#include "tiling.h"
+#include "typed.h"
+#include "window.h"
+
+#ifndef DSA_SOFT_MODEL
+#error "The sweep runs on the software model. Compile it with -DDSA_SOFT_MODEL."
+#endif
+
+/*!
+ * \brief The name of the variant of spec.h, given by sweep.py.
+ */
+#ifndef DSA_SWEEP_VARIANT
+#define DSA_SWEEP_VARIANT "default"
+#endif
+
+/*!
+ * \brief The elements of each dimension of the kernels.
+ */
+#ifndef DSA_SWEEP_SIZE
+#define DSA_SWEEP_SIZE 128
+#endif
+
+/*!
+ * \brief Run a kernel on the model, and append its record to the output.
+ * \param bytes The bytes of the payload of the kernel.
+ */
+template<typename F>
+void Sweep(FILE *out, const char *name, uint64_t bytes, F kernel) {
+  DSA_MODEL_RESET();
+  kernel();
+  SS_WAIT_ALL();
+  DSAModelStats stats = DSA_MODEL_STATS();
+  double cycles = stats.cycles;
+  fprintf(out, "{\"variant\": \"%s\", \"name\": \"%s\", \"bytes\": %" PRIu64 ", "
+          "\"cycles\": %.0f, \"bytes_per_cycle\": %.3f, \"insts\": %" PRIu64 ", "
+          "\"streams\": %" PRIu64 ", \"epochs\": %" PRIu64 ", \"ctrl_ratio\": %.3f, "
+          "\"spad_high\": %" PRIu64 ", \"spad_occupancy\": %.3f}\n",
+          DSA_SWEEP_VARIANT, name, bytes, cycles, cycles > 0 ? bytes / cycles : 0.0,
+          stats.insts, stats.streams, stats.epochs,
+          cycles > 0 ? stats.insts * DSA_MODEL_INST_CYCLES / cycles : 0.0,
+          stats.spad_high, (double) stats.spad_high / SCRATCH_SIZE);
+}
+
+int main(int argc, char **argv) {
+  FILE *out = argc > 1 ? fopen(argv[1], "a") : stdout;
+  if (!out) {
+    perror(argv[1]);
+    return 1;
+  }
+  const uint64_t n = DSA_SWEEP_SIZE;
+  std::vector<uint64_t> a(n * n), b(a.size()), c(a.size());
+
+  Sweep(out, "SS_GEMM", 4 * n * n * 8, [&]() {
+    static constexpr GemmPorts gp{0, 1, 2, 0, 3, 1};
+    GemmAttr ga;
+    ga.a = a.data();
+    ga.b = b.data();
+    ga.c = c.data();
+    ga.m = ga.n = ga.k = n;
+    ga.lda = ga.ldb = ga.ldc = n;
+    SS_GEMM(&ga, &gp);
+  });
+
+  Sweep(out, "SS_CONV2D", 2 * n * n * 4, [&]() {
+    static constexpr ConvPorts cp{0, 1, 2, 0};
+    ConvAttr ca;
+    ca.in = a.data();
+    ca.h = ca.w = ca.pitch = n;
+    ca.weight = b.data();
+    ca.k = 3;
+    ca.pad = 1;
+    ca.out = c.data();
+    ca.out_pitch = n;
+    SS_CONV2D(&ca, &cp);
+  });
+
+  Sweep(out, "SS_STENCIL5", 2 * n * n * 8, [&]() {
+    static constexpr StencilPorts sp{0, 1, 2, 3, 0};
+    StencilAttr sa;
+    sa.in = a.data();
+    sa.out = c.data();
+    sa.h = sa.w = n;
+    sa.c0 = sa.c1 = 0;
+    SS_STENCIL5(&sa, &sp);
+  });
+
+  static constexpr ReducePorts rp{0, 1, 0, 1};
+  Sweep(out, "SS_REDUCE", n * n * 8, [&]() {
+    SS_REDUCE(&rp, a.data(), n * n, 0);
+  });
+
+  Sweep(out, "SS_SCAN", 2 * n * n * 8, [&]() {
+    SS_SCAN(&rp, a.data(), c.data(), n * n, 0);
+  });
+
+  Sweep(out, "SS_WINDOWS", n * n * 8, [&]() {
+    static constexpr WindowPorts wp{0, 0, 1};
+    WindowAttr wa;
+    wa.src = a.data();
+    wa.n = n * n;
+    wa.w = 5;
+    wa.step = 1;
+    wa.ring = WINDOW_RING_MIN(wa.w, 64, wa.dtype);
+    SS_WINDOWS(&wa, &wp);
+  });
+
+  // A ragged matrix, whose edges are padded by the streams.
+  Sweep(out, "SS_TILE", 2 * (n - 3) * (n - 5) * 8, [&]() {
+    TileAttr ta;
+    ta.a = a.data();
+    ta.m = n - 3;
+    ta.n = ta.ld = n - 5;
+    ta.tm = ta.tn = 16;
+    ta.vec = 8;
+    SS_FOR_TILES(&ta, [&](uint64_t i0, uint64_t j0) {
+      SS_TILE_READ(&ta, i0, j0, 0, TILE_PADDING(true));
+      SS_TILE_WRITE(&ta, i0, j0, 1);
+    });
+  });
+
+  // The sub-word elements, packed by the granularity and the sub-lanes.
+  Sweep(out, "SS_READ_OF.u8", 2 * n * n, [&]() {
+    SS_READ_OF((const uint8_t *) a.data(), n * n, 0);
+    SS_WRITE_OF(0, (uint8_t *) c.data(), n * n);
+  });
+
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+
+"""The design-space sweep of the kernels over a grid of spec.h overrides.
+
+Each point of the grid is a set of -D flags overriding the macros of spec.h, or of the
+kernels, e.g. DSA_REDUCE_ACCS or GEMM_VEC. For each point, sweep.cc is built with the flags
+on the software model and run, and the records of its kernels are tabulated with the
+throughput, the scratchpad occupancy, and the control overhead of each variant.
+
+The software model costs the streams by their bytes over MEM_WIDTH, SCR_WIDTH, and
+PORT_WIDTH, and the scratchpad by SCRATCH_SIZE. It does not model the lanes and the ports
+themselves, so sweeping DSA_XLEN, DSA_GRANULARITY, DSA_SUB_LANES, DSA_MAX_PORTS, or the
+other macros of `unmodeled` gives identical rows. They are rejected unless --unmodeled.
+"""
+
+import argparse
+import itertools
+import json
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+
+root = os.path.dirname(os.path.abspath(__file__))
+
+default_grid = ['MEM_WIDTH=32,64', 'SCR_WIDTH=32,64', 'SCRATCH_SIZE=65536,1048576']
+
+# The macros of spec.h which the software model ignores.
+unmodeled = ['DSA_XLEN', 'MAX_PORT_BITS', 'DSA_MAX_PORTS', 'DSA_MAX_IN_PORTS',
+             'DSA_MAX_OUT_PORTS', 'DSA_GRANULARITY', 'DSA_SUB_LANES',
+             'DSA_REPEAT_DIGITAL_POINT', 'DSA_MAX_HARTS']
+
+def parse_grid(specs):
+    """The list of (macro, values) of the grid, each spec as MACRO=v1,v2,..."""
+    res = []
+    for spec in specs:
+        if '=' not in spec:
+            raise ValueError('The grid should be MACRO=v1,v2,...: %s' % spec)
+        name, values = spec.split('=', 1)
+        res.append((name, values.split(',')))
+    return res
+
+def check_modeled(grid, allow):
+    """Reject the macros of the grid ignored by the model, or only warn if allowed."""
+    names = [name for name, _ in grid if name in unmodeled]
+    if not names:
+        return
+    msg = 'The software model ignores %s, so their variants would be identical.' % \
+          ', '.join(names)
+    if not allow:
+        raise ValueError(msg + ' Pass --unmodeled to sweep them anyway.')
+    sys.stderr.write('warning: %s\n' % msg)
+
+def variants(grid):
+    """Yield the (name, flags) of each point of the grid."""
+    names = [name for name, _ in grid]
+    for values in itertools.product(*[values for _, values in grid]):
+        point = list(zip(names, values))
+        name = ' '.join('%s=%s' % i for i in point) or 'default'
+        yield name, ['-D%s=%s' % i for i in point]
+
+def run(cxx, flags, name, defines, workdir):
+    """Build and run sweep.cc of the variant, and return its records."""
+    binary = os.path.join(workdir, 'sweep')
+    cmd = [cxx] + flags + defines + ['-DDSA_SOFT_MODEL', '-DDSA_SWEEP_VARIANT="%s"' % name,
+                                     os.path.join(root, 'sweep.cc'), '-o', binary]
+    subprocess.check_call(cmd)
+    out = subprocess.check_output([binary], universal_newlines=True)
+    return [json.loads(line) for line in out.splitlines() if line.strip()]
+
+def tabulate(records, key):
+    """A table per kernel, a row per variant, and the best variant by the key."""
+    kernels = []
+    for entry in records:
+        if entry['name'] not in kernels:
+            kernels.append(entry['name'])
+    width = max(len(entry['variant']) for entry in records)
+    for kernel in kernels:
+        rows = [entry for entry in records if entry['name'] == kernel]
+        print('%s:' % kernel)
+        print('  %-*s %10s %8s %8s %6s %7s' %
+              (width, 'variant', 'cycles', 'B/cycle', 'insts', 'ctrl', 'spad'))
+        for entry in rows:
+            print('  %-*s %10d %8.2f %8d %5.0f%% %6.1f%%%s' %
+                  (width, entry['variant'], entry['cycles'], entry['bytes_per_cycle'],
+                   entry['insts'], entry['ctrl_ratio'] * 100, entry['spad_occupancy'] * 100,
+                   ' !' if entry['spad_occupancy'] > 1 else ''))
+        fits = [entry for entry in rows if entry['spad_occupancy'] <= 1]
+        if fits:
+            best = max(fits, key=lambda entry: entry[key])
+            print('  best by %s: %s' % (key, best['variant']))
+        print()
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('grid', nargs='*', help='The values of a macro, as MACRO=v1,v2,... '
+                        'The grid is their product. By default, %s.' % ' '.join(default_grid))
+    parser.add_argument('--cxx', default=os.getenv('CXX', 'g++'))
+    parser.add_argument('--flags', default='-std=c++17 -O2',
+                        help='The flags of all the variants, e.g. the include paths.')
+    parser.add_argument('--best', default='bytes_per_cycle',
+                        help='The field of the records to pick the best variant by.')
+    parser.add_argument('--json', action='store_true', help='Print the records instead.')
+    parser.add_argument('--unmodeled', action='store_true',
+                        help='Only warn on the macros ignored by the model, e.g. to check '
+                        'that the kernels build with them.')
+    args = parser.parse_args()
+
+    grid = parse_grid(args.grid or default_grid)
+    check_modeled(grid, args.unmodeled)
+    records = []
+    with tempfile.TemporaryDirectory() as workdir:
+        for name, defines in variants(grid):
+            sys.stderr.write('%s\n' % name)
+            records += run(args.cxx, shlex.split(args.flags), name, defines, workdir)
+
+    if args.json:
+        for entry in records:
+            print(json.dumps(entry))
+    else:
+        tabulate(records, args.best)
+
+if __name__ == '__main__':
+    main()
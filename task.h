@@ -0,0 +1,295 @@
+/*!
+ * \file task.h
+ * \author PolyArch Research Lab
+ * \brief A host-side task graph. Kernels are submitted as tasks declaring the ports and
+ *        the memory regions they access, and the scheduler dispatches each task to an idle
+ *        lane once the tasks it depends on are done, so that independent tasks overlap.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The max number of tasks in flight in a task graph.
+ */
+#ifndef DSA_TASK_MAX
+#define DSA_TASK_MAX 64
+#endif
+
+/*!
+ * \brief The max number of lanes a task graph dispatches tasks to.
+ */
+#ifndef DSA_TASK_MAX_LANES
+#define DSA_TASK_MAX_LANES 8
+#endif
+
+enum TaskAccessKind {
+  DTK_InPort,   // An input port fed by the task
+  DTK_OutPort,  // An output port drained by the task
+  DTK_Read,     // A memory region read by the task
+  DTK_Write,    // A memory region written by the task
+};
+
+/*!
+ * \brief A characteristic of a task: a port it occupies, or a memory region it accesses.
+ */
+struct TaskAccess {
+  TaskAccessKind kind;
+  /*!
+   * \brief The port number, or the memory type of the region.
+   */
+  int port;
+  /*!
+   * \brief The region [addr, addr+bytes).
+   */
+  uint64_t addr{0}, bytes{0};
+};
+
+/*!
+ * \brief A type of tasks sharing a spatial architecture configuration.
+ */
+struct TaskType {
+  REG config;
+  REG size;
+};
+
+enum TaskState {
+  DTS_Free,
+  DTS_Pending,
+  DTS_Running,
+};
+
+/*!
+ * \brief The function launching the streams of a task on the given lane.
+ *        It should not block on the accelerator.
+ */
+typedef void (*DSATaskFunc)(void *arg, int lane);
+
+struct DSATask {
+  TaskState state{DTS_Free};
+  int type;
+  DSATaskFunc func;
+  void *arg;
+  /*!
+   * \brief The submission order. A task only depends on the tasks submitted before it.
+   */
+  uint64_t seq;
+  int lane;
+  int n_acc;
+  TaskAccess acc[NUM_TASK_DEP_CHARAC];
+};
+
+struct DSATaskGraph {
+  /*!
+   * \brief The number of lanes to dispatch tasks to. Lane i is bit i of SS_CONTEXT.
+   */
+  int lanes;
+  /*!
+   * \brief The task types, at most NUM_TASK_TYPE_CHARAC.
+   */
+  int n_types{0};
+  TaskType types[NUM_TASK_TYPE_CHARAC];
+  DSATask tasks[DSA_TASK_MAX];
+  uint64_t seq{0};
+  /*!
+   * \brief The type configured on each lane (-1 if none), and the tasks running on it.
+   */
+  int configured[DSA_TASK_MAX_LANES];
+  int running[DSA_TASK_MAX_LANES];
+};
+
+/*! \brief Reset the task graph. */
+inline void DSA_TASK_INIT(DSATaskGraph *g, int lanes) {
+  g->lanes = lanes < DSA_TASK_MAX_LANES ? lanes : DSA_TASK_MAX_LANES;
+  g->n_types = 0;
+  g->seq = 0;
+  for (int i = 0; i < DSA_TASK_MAX; ++i) {
+    g->tasks[i].state = DTS_Free;
+  }
+  for (int i = 0; i < g->lanes; ++i) {
+    g->configured[i] = -1;
+    g->running[i] = 0;
+  }
+}
+
+/*!
+ * \brief Register a task type.
+ * \return The index of the task type, or -1 if there are already NUM_TASK_TYPE_CHARAC types.
+ */
+inline int DSA_TASK_TYPE(DSATaskGraph *g, REG config, REG size) {
+  if (g->n_types == NUM_TASK_TYPE_CHARAC) {
+    return -1;
+  }
+  g->types[g->n_types].config = config;
+  g->types[g->n_types].size = size;
+  return g->n_types++;
+}
+
+/*! \brief If the two accesses conflict when the two tasks run at the same time. */
+inline bool _TASK_CONFLICT(const TaskAccess *a, const TaskAccess *b) {
+  if (a->kind == DTK_InPort || a->kind == DTK_OutPort) {
+    return a->kind == b->kind && a->port == b->port;
+  }
+  if (b->kind == DTK_InPort || b->kind == DTK_OutPort) {
+    return false;
+  }
+  bool overlap = a->port == b->port && a->addr < b->addr + b->bytes && b->addr < a->addr + a->bytes;
+  return overlap && (a->kind == DTK_Write || b->kind == DTK_Write);
+}
+
+/*! \brief If task b conflicts with task a on the memory regions, or also on the ports. */
+inline bool _TASK_DEPENDS(const DSATask *a, const DSATask *b, bool ports) {
+  for (int i = 0; i < a->n_acc; ++i) {
+    bool is_port = a->acc[i].kind == DTK_InPort || a->acc[i].kind == DTK_OutPort;
+    if (is_port && !ports) {
+      continue;
+    }
+    for (int j = 0; j < b->n_acc; ++j) {
+      if (_TASK_CONFLICT(a->acc + i, b->acc + j)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/*! \brief Retire the tasks on the lanes whose streams are all done. */
+inline void _TASK_RETIRE(DSATaskGraph *g) {
+  for (int lane = 0; lane < g->lanes; ++lane) {
+    if (!g->running[lane]) {
+      continue;
+    }
+    SS_CONTEXT(1ull << lane);
+    if (!SS_POLL(~0ull)) {
+      continue;
+    }
+    for (int i = 0; i < DSA_TASK_MAX; ++i) {
+      if (g->tasks[i].state == DTS_Running && g->tasks[i].lane == lane) {
+        g->tasks[i].state = DTS_Free;
+      }
+    }
+    g->running[lane] = 0;
+  }
+}
+
+/*!
+ * \brief Pick a lane for the ready task: a lane already configured with its type, with no
+ *        running task occupying the same ports, or an idle lane otherwise.
+ * \return The lane, or -1 if none is available now.
+ */
+inline int _TASK_LANE(DSATaskGraph *g, const DSATask *t) {
+  int idle = -1;
+  for (int lane = 0; lane < g->lanes; ++lane) {
+    if (!g->running[lane]) {
+      if (g->configured[lane] == t->type) {
+        return lane;
+      }
+      idle = idle == -1 ? lane : idle;
+      continue;
+    }
+    if (g->configured[lane] != t->type) {
+      continue;
+    }
+    bool free = true;
+    for (int i = 0; i < DSA_TASK_MAX && free; ++i) {
+      const DSATask *u = g->tasks + i;
+      free = !(u->state == DTS_Running && u->lane == lane && _TASK_DEPENDS(t, u, true));
+    }
+    if (free) {
+      return lane;
+    }
+  }
+  return idle;
+}
+
+/*!
+ * \brief Dispatch the pending tasks whose dependences are all done, in submission order.
+ * \return The number of tasks dispatched.
+ */
+inline int _TASK_DISPATCH(DSATaskGraph *g) {
+  int res = 0;
+  for (int i = 0; i < DSA_TASK_MAX; ++i) {
+    DSATask *t = g->tasks + i;
+    if (t->state != DTS_Pending) {
+      continue;
+    }
+    bool ready = true;
+    for (int j = 0; j < DSA_TASK_MAX && ready; ++j) {
+      const DSATask *u = g->tasks + j;
+      ready = !(u->state != DTS_Free && u->seq < t->seq && _TASK_DEPENDS(t, u, false));
+    }
+    int lane = ready ? _TASK_LANE(g, t) : -1;
+    if (lane == -1) {
+      continue;
+    }
+    SS_CONTEXT(1ull << lane);
+    if (g->configured[lane] != t->type) {
+      SS_CONFIG(g->types[t->type].config, g->types[t->type].size);
+      g->configured[lane] = t->type;
+    }
+    t->func(t->arg, lane);
+    t->state = DTS_Running;
+    t->lane = lane;
+    ++g->running[lane];
+    ++res;
+  }
+  return res;
+}
+
+/*!
+ * \brief Run the task graph until all the tasks are done.
+ */
+inline void DSA_TASK_WAIT_ALL(DSATaskGraph *g) {
+  for (;;) {
+    _TASK_RETIRE(g);
+    _TASK_DISPATCH(g);
+    bool done = true;
+    for (int i = 0; i < DSA_TASK_MAX && done; ++i) {
+      done = g->tasks[i].state == DTS_Free;
+    }
+    if (done) {
+      break;
+    }
+  }
+  SS_CONTEXT(g->lanes >= 64 ? ~0ull : (1ull << g->lanes) - 1);
+}
+
+/*!
+ * \brief Submit a task. The ports and the regions accessed are declared by acc,
+ *        at most NUM_TASK_DEP_CHARAC of them. If the graph is full, the scheduler runs
+ *        until a task retires. The task is dispatched as soon as it is ready.
+ * \param type The index of the task type, returned by DSA_TASK_TYPE.
+ * \return The slot of the task, or -1 if the type is not registered, e.g. the -1 of a full
+ *         DSA_TASK_TYPE, or if it declares more than NUM_TASK_DEP_CHARAC accesses, since
+ *         dropping any of them would lose a hazard.
+ */
+inline int DSA_TASK_SUBMIT(DSATaskGraph *g, int type, DSATaskFunc func, void *arg,
+                           const TaskAccess *acc, int n_acc) {
+  if (type < 0 || type >= g->n_types || n_acc < 0 || n_acc > NUM_TASK_DEP_CHARAC) {
+    return -1;
+  }
+  int slot = -1;
+  while (slot == -1) {
+    for (int i = 0; i < DSA_TASK_MAX && slot == -1; ++i) {
+      slot = g->tasks[i].state == DTS_Free ? i : -1;
+    }
+    if (slot == -1) {
+      _TASK_RETIRE(g);
+      _TASK_DISPATCH(g);
+    }
+  }
+  DSATask *t = g->tasks + slot;
+  t->type = type;
+  t->func = func;
+  t->arg = arg;
+  t->seq = g->seq++;
+  t->n_acc = n_acc;
+  for (int i = 0; i < t->n_acc; ++i) {
+    t->acc[i] = acc[i];
+  }
+  t->state = DTS_Pending;
+  _TASK_DISPATCH(g);
+  return slot;
+}
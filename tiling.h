@@ -0,0 +1,137 @@
+/*!
+ * \file tiling.h
+ * \author PolyArch Research Lab
+ * \brief Tiling a matrix with the ragged edges padded by the streams, so that the spatial
+ *        configuration always processes the tiles of the same shape, and the host never runs a
+ *        scalar epilogue. The ports should be compile-time constants.
+ *        A tile of tm x tn is fed as tn/vec column strips, each of tm rows of a vector:
+ *        \code{c}
+ *          for (s = 0; s < tn / vec; ++s)
+ *            for (i = 0; i < tm; ++i)
+ *              port <- a[i0+i][j0+s*vec : j0+s*vec+vec]
+ *        \endcode
+ *        At the edges, a partial vector is padded by the Padding mode of the stream, and the
+ *        whole vectors beyond the matrix are fed as zeros.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief A row-major matrix of m x n elements, tiled by tm x tn.
+ */
+struct TileAttr {
+  REG a;
+  uint64_t m, n;
+  /*!
+   * \brief The elements between two rows.
+   */
+  uint64_t ld;
+  int dtype{8};
+  int memory{DMT_DMA};
+  /*!
+   * \brief The tile shape, where tn is a multiple of vec, the lanes of the port.
+   */
+  uint64_t tm, tn;
+  uint64_t vec;
+};
+
+/*!
+ * \brief The padding of the partial vectors at the edges.
+ * \param per_lane If each lane of the vector produces its own output written back by
+ *                 SS_TILE_WRITE, the padded lanes are predicated off, so that they produce
+ *                 nothing. Otherwise, e.g. a reduction across the lanes, they are zeros.
+ */
+inline Padding TILE_PADDING(bool per_lane) {
+  return per_lane ? DP_PostStridePredOff : DP_PostStrideZero;
+}
+
+/*! \brief The rows of the tile at i0 within the matrix. */
+inline uint64_t TILE_ROWS(const TileAttr *ta, uint64_t i0) {
+  return ta->m - i0 < ta->tm ? ta->m - i0 : ta->tm;
+}
+
+/*! \brief The columns of the tile at j0 within the matrix. */
+inline uint64_t TILE_COLS(const TileAttr *ta, uint64_t j0) {
+  return ta->n - j0 < ta->tn ? ta->n - j0 : ta->tn;
+}
+
+/*!
+ * \brief Feed the tile at (i0, j0) to the port, padded to tm x tn.
+ *        A full tile is a single 3D stream. An edge tile is a 2D stream per strip within the
+ *        matrix, and the zeros of the rows below the matrix and the strips beyond it.
+ */
+DSA_INLINE void SS_TILE_READ(const TileAttr *ta, uint64_t i0, uint64_t j0, int port,
+                             Padding padding) {
+  uint64_t bm = TILE_ROWS(ta, i0);
+  uint64_t bn = TILE_COLS(ta, j0);
+  int d = ta->dtype;
+  REG addr = ta->a.value + (i0 * ta->ld + j0) * d;
+  if (bm == ta->tm && bn == ta->tn) {
+    INSTANTIATE_3D_STREAM(addr, (uint64_t) 1, ta->vec, ta->ld, (uint64_t) 0, ta->tm,
+                          (uint64_t) 0, (uint64_t) 0, (uint64_t) 0, (uint64_t) 0,
+                          ta->vec, ta->tn / ta->vec,
+                          port, DP_NoPadding, DSA_Access, DMO_Read, ta->memory, d, 0);
+    return;
+  }
+  for (uint64_t s = 0; s < ta->tn; s += ta->vec) {
+    if (s < bn) {
+      uint64_t w = bn - s < ta->vec ? bn - s : ta->vec;
+      INSTANTIATE_2D_STREAM(addr.value + s * d, (uint64_t) 1, w, ta->ld, (uint64_t) 0, bm,
+                            port, w < ta->vec ? padding : DP_NoPadding, DSA_Access, DMO_Read,
+                            ta->memory, d, 0);
+      if (bm < ta->tm) {
+        SS_CONST(port, (uint64_t) 0, (ta->tm - bm) * ta->vec, d);
+      }
+    } else {
+      SS_CONST(port, (uint64_t) 0, ta->tm * ta->vec, d);
+    }
+  }
+}
+
+/*!
+ * \brief Write the outputs of the tile at (i0, j0) from the port back to the matrix, in the
+ *        same order as SS_TILE_READ. The partial vectors are expected to be predicated off by
+ *        TILE_PADDING(true), so that only their valid lanes are emitted. The outputs of the
+ *        zeros fed beyond the matrix are discarded.
+ */
+DSA_INLINE void SS_TILE_WRITE(const TileAttr *ta, uint64_t i0, uint64_t j0, int port) {
+  uint64_t bm = TILE_ROWS(ta, i0);
+  uint64_t bn = TILE_COLS(ta, j0);
+  int d = ta->dtype;
+  REG addr = ta->a.value + (i0 * ta->ld + j0) * d;
+  if (bm == ta->tm && bn == ta->tn) {
+    INSTANTIATE_3D_STREAM(addr, (uint64_t) 1, ta->vec, ta->ld, (uint64_t) 0, ta->tm,
+                          (uint64_t) 0, (uint64_t) 0, (uint64_t) 0, (uint64_t) 0,
+                          ta->vec, ta->tn / ta->vec,
+                          port, DP_NoPadding, DSA_Access, DMO_Write, ta->memory, d, 0);
+    return;
+  }
+  for (uint64_t s = 0; s < ta->tn; s += ta->vec) {
+    if (s < bn) {
+      uint64_t w = bn - s < ta->vec ? bn - s : ta->vec;
+      INSTANTIATE_2D_STREAM(addr.value + s * d, (uint64_t) 1, w, ta->ld, (uint64_t) 0, bm,
+                            port, DP_NoPadding, DSA_Access, DMO_Write, ta->memory, d, 0);
+      if (bm < ta->tm) {
+        SS_GARBAGE_GENERAL(port, (ta->tm - bm) * ta->vec, d);
+      }
+    } else {
+      SS_GARBAGE_GENERAL(port, ta->tm * ta->vec, d);
+    }
+  }
+}
+
+/*!
+ * \brief Call body(i0, j0) for each tile in the row-major order, the full and the edge tiles
+ *        alike.
+ */
+template<typename F>
+DSA_INLINE void SS_FOR_TILES(const TileAttr *ta, F body) {
+  for (uint64_t i0 = 0; i0 < ta->m; i0 += ta->tm) {
+    for (uint64_t j0 = 0; j0 < ta->n; j0 += ta->tn) {
+      body(i0, j0);
+    }
+  }
+}
@@ -0,0 +1,175 @@
+/*!
+ * \file typed.h
+ * \author PolyArch Research Lab
+ * \brief Type-generic wrappers, which take typed pointers and element counts, and derive the
+ *        data types of the streams from the element type at compile time.
+ *        Each element type is streamed in its narrowest legal encoding, DSA_DTYPE_OF<T>(),
+ *        so that the sub-word data is packed at the full width of the ports, and decomposed
+ *        to the sub-lanes. Types narrower than the finest sub-lane are packed into words of
+ *        the finest sub-lane, so the bytes streamed should be a multiple of it.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include <string.h>
+
+#include <type_traits>
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The bytes of the finest sub-lane, DSA_XLEN decomposed DSA_SUB_LANES times,
+ *        but no finer than DSA_GRANULARITY.
+ */
+constexpr int DSA_MIN_DTYPE() {
+  return ((DSA_XLEN >> DSA_SUB_LANES) > DSA_GRANULARITY ? (DSA_XLEN >> DSA_SUB_LANES)
+                                                         : DSA_GRANULARITY) / 8;
+}
+
+/*!
+ * \brief The narrowest legal encoding of T in bytes: the largest power of two dividing its
+ *        size, up to a word, and at least the finest sub-lane.
+ */
+template<typename T>
+constexpr int DSA_DTYPE_OF() {
+  static_assert(std::is_trivially_copyable<T>::value, "Only the plain data can be streamed.");
+  constexpr int low = (int) (sizeof(T) & -sizeof(T));
+  constexpr int word = low < 8 ? low : 8;
+  return word > DSA_MIN_DTYPE() ? word : DSA_MIN_DTYPE();
+}
+
+/*!
+ * \brief If T is an element of its own encoding, which is required by the indirect streams
+ *        and the values received, where each element is accessed individually.
+ */
+template<typename T>
+constexpr bool DSA_EXACT_OF() {
+  return sizeof(T) == DSA_DTYPE_OF<T>();
+}
+
+/*! \brief The number of encoded words of n elements of T. */
+template<typename T>
+constexpr uint64_t DSA_WORDS_OF(uint64_t n) {
+  return n * sizeof(T) / DSA_DTYPE_OF<T>();
+}
+
+/*!
+ * \brief The DTYPE_MASK of the direct and the const streams of T.
+ */
+template<typename T>
+constexpr uint64_t DTYPE_MASK_OF() {
+  return (_LOG2(DSA_DTYPE_OF<T>()) << 2) | _LOG2(DSA_DTYPE_OF<T>());
+}
+
+/*!
+ * \brief The bits of a value of T, replicated to fill its encoding if T is narrower.
+ *        T wider than its encoding, e.g. a struct of several words, has no such bits.
+ */
+template<typename T>
+inline uint64_t DSA_BITS_OF(const T &value) {
+  static_assert(sizeof(T) <= DSA_DTYPE_OF<T>(), "T should fit in one word of its encoding.");
+  uint64_t res = 0;
+  memcpy(&res, &value, sizeof(T) < 8 ? sizeof(T) : 8);
+  for (int i = sizeof(T); i < DSA_DTYPE_OF<T>(); i *= 2) {
+    res |= res << (i * 8);
+  }
+  return res;
+}
+
+/*!
+ * \brief addr[0:n] -> port
+ */
+template<typename T>
+DSA_INLINE void SS_READ_OF(const T *addr, uint64_t n, int port,
+                           Padding padding = DP_NoPadding, MemoryType source = DMT_DMA) {
+  SS_1D_READ((uint64_t) addr, n * sizeof(T), port, padding, source, DSA_DTYPE_OF<T>());
+}
+
+/*!
+ * \brief port -> addr[0:n]
+ */
+template<typename T>
+DSA_INLINE void SS_WRITE_OF(int port, T *addr, uint64_t n, MemoryType source = DMT_DMA) {
+  SS_1D_WRITE(port, addr, n * sizeof(T), source, DSA_DTYPE_OF<T>());
+}
+
+/*!
+ * \brief n rows of len elements, addr + i*stride -> port, where stride is in elements.
+ * \param stretch The elements added to len after each row.
+ */
+template<typename T>
+DSA_INLINE void SS_2D_READ_OF(const T *addr, uint64_t stride, uint64_t len, uint64_t n, int port,
+                              Padding padding = DP_NoPadding, MemoryType source = DMT_DMA,
+                              int64_t stretch = 0) {
+  constexpr int d = DSA_DTYPE_OF<T>();
+  INSTANTIATE_2D_STREAM((uint64_t) addr, (uint64_t) 1, DSA_WORDS_OF<T>(len),
+                        DSA_WORDS_OF<T>(stride), (uint64_t) (stretch * (int64_t) sizeof(T) / d), n,
+                        port, padding, DSA_Access, DMO_Read, source, d, 0);
+}
+
+/*!
+ * \brief port -> n rows of len elements, addr + i*stride, where stride is in elements.
+ */
+template<typename T>
+DSA_INLINE void SS_2D_WRITE_OF(int port, T *addr, uint64_t stride, uint64_t len, uint64_t n,
+                               MemoryType source = DMT_DMA) {
+  constexpr int d = DSA_DTYPE_OF<T>();
+  INSTANTIATE_2D_STREAM((uint64_t) addr, (uint64_t) 1, DSA_WORDS_OF<T>(len),
+                        DSA_WORDS_OF<T>(stride), (uint64_t) 0, n,
+                        port, DP_NoPadding, DSA_Access, DMO_Write, source, d, 0);
+}
+
+/*!
+ * \brief Feed n copies of the value to the port, packed if T is narrower than its encoding.
+ *        A const stream repeats a single word, so T should not be wider than its encoding.
+ */
+template<typename T>
+DSA_INLINE void SS_CONST_OF(int port, const T &value, uint64_t n) {
+  SS_CONST(port, DSA_BITS_OF(value), DSA_WORDS_OF<T>(n), DSA_DTYPE_OF<T>());
+}
+
+/*!
+ * \brief Forward n elements from the output port to the input port.
+ */
+template<typename T>
+DSA_INLINE void SS_RECURRENCE_OF(int oport, int iport, uint64_t n) {
+  SS_RECURRENCE(oport, iport, DSA_WORDS_OF<T>(n), DSA_DTYPE_OF<T>());
+}
+
+/*!
+ * \brief Receive a value of T from the port.
+ */
+template<typename T>
+DSA_INLINE T SS_RECV_OF(int port) {
+  static_assert(DSA_EXACT_OF<T>(), "The value received should be of a legal encoding.");
+  uint64_t bits = SS_RECV(port, sizeof(T));
+  T res;
+  memcpy(&res, &bits, sizeof(T));
+  return res;
+}
+
+/*!
+ * \brief Gather a[b[i]] of n elements to the port, where the indices of I come from idx_port.
+ */
+template<typename T, typename I>
+DSA_INLINE void SS_INDIRECT_READ_OF(int in_port, int idx_port, const T *a, uint64_t n,
+                                    MemoryType memory = DMT_DMA) {
+  static_assert(DSA_EXACT_OF<T>() && DSA_EXACT_OF<I>(),
+                "The elements and the indices gathered should be of legal encodings.");
+  INSTANTIATE_1D_INDIRECT(in_port, sizeof(T), idx_port, sizeof(I), (uint64_t) a, (uint64_t) 1,
+                          n, memory, DMO_Read, false, false);
+}
+
+/*!
+ * \brief The atomic update a[b[i]] op= c[i] of n elements, where the indices of I come from
+ *        idx_port, and the operands c come from operand_port.
+ */
+template<typename T, typename I>
+DSA_INLINE void SS_INDIRECT_ATOMIC_OF(int operand_port, int idx_port, T *a, uint64_t n,
+                                      MemoryOperation operation, MemoryType memory = DMT_SPAD) {
+  static_assert(DSA_EXACT_OF<T>() && DSA_EXACT_OF<I>(),
+                "The elements and the indices updated should be of legal encodings.");
+  INSTANTIATE_1D_INDIRECT(operand_port, sizeof(T), idx_port, sizeof(I), (uint64_t) a,
+                          (uint64_t) 1, n, memory, operation, false, false);
+}
@@ -0,0 +1,94 @@
+/*!
+ * \file window.h
+ * \author PolyArch Research Lab
+ * \brief Sliding windows over a long input streamed through a buffet in the scratchpad.
+ *        The producer moves the input from the memory to the buffet, and the consumer reads
+ *        the overlapping windows from the buffet, so each element is fetched from the memory
+ *        once, and the scratchpad used is bounded by the ring of the buffet instead of the
+ *        input. The streams address the buffet as if it held the whole input from the start of
+ *        the ring, i.e. spad plus the byte offset in the input, and the buffet wraps them
+ *        around the ring [spad, spad+ring). A write waits for the space released, and a read
+ *        waits for the data written.
+ *        The ports should be compile-time constants.
+ * \copyright Copyright (c) 2020
+ */
+
+#pragma once
+
+#include "dsaintrin.h"
+
+/*!
+ * \brief The ports of the windows. The configuration passes in_pass to out_pass, which
+ *        fills the buffet, and consumes the windows on in_win.
+ */
+struct WindowPorts {
+  int in_pass, out_pass, in_win;
+};
+
+/*!
+ * \brief The windows of w elements every step elements over n elements of the input.
+ */
+struct WindowAttr {
+  REG src;
+  uint64_t n;
+  int dtype{8};
+  int memory{DMT_DMA};
+  uint64_t w, step;
+  /*!
+   * \brief The ring of the buffet, [spad, spad+ring) in bytes, of at least WINDOW_RING_MIN.
+   */
+  uint64_t spad{0};
+  uint64_t ring;
+  /*!
+   * \brief The padding of each window, which completes its last vector.
+   */
+  Padding padding{DP_NoPadding};
+};
+
+/*! \brief The number of windows. */
+inline uint64_t WINDOW_COUNT(const WindowAttr *wa) {
+  return wa->n < wa->w ? 0 : (wa->n - wa->w) / wa->step + 1;
+}
+
+/*!
+ * \brief The smallest ring in bytes, which holds a window and the step the producer runs
+ *        ahead, in whole lines of the scratchpad.
+ */
+inline uint64_t WINDOW_RING_MIN(uint64_t w, uint64_t step, int dtype) {
+  uint64_t bytes = (w + step) * dtype;
+  return (bytes + SCR_WIDTH - 1) / SCR_WIDTH * SCR_WIDTH;
+}
+
+/*!
+ * \brief The buffet state of the read of the windows, the bytes released from the head of the
+ *        buffet after each 1D stream, i.e. the step of the windows.
+ */
+inline uint64_t BUFFET_STATE(uint64_t release) {
+  return release & 0xffffffffu;
+}
+
+/*!
+ * \brief Stream the input through the buffet, and feed the windows to in_win, e.g. the taps
+ *        of a 1D convolution or a moving average, or for a stencil over the rows of width W,
+ *        the windows of 3W elements every W elements.
+ *        The buffet registers only last one stream, so both the fill and the windows
+ *        allocate it.
+ */
+DSA_INLINE void SS_WINDOWS(const WindowAttr *wa, const WindowPorts *p) {
+  uint64_t windows = WINDOW_COUNT(wa);
+  if (!windows) {
+    return;
+  }
+  int d = wa->dtype;
+  assert(wa->ring >= WINDOW_RING_MIN(wa->w, wa->step, d) && wa->spad + wa->ring <= SCRATCH_SIZE);
+  // The elements of the input covered by the windows.
+  uint64_t used = (windows - 1) * wa->step + wa->w;
+  int start = (int) wa->spad, end = (int) (wa->spad + wa->ring);
+  SS_1D_READ(wa->src, used * d, p->in_pass, DP_NoPadding, (MemoryType) wa->memory, d);
+  SS_BUFFET_ALLOC(start, end);
+  SS_1D_WRITE(p->out_pass, wa->spad, used * d, DMT_SPAD, d);
+  SS_BUFFET_ALLOC(start, end);
+  CONFIG_PARAM(DSARF::BSR, BUFFET_STATE(wa->step * d), 0);
+  INSTANTIATE_2D_STREAM(wa->spad, (uint64_t) 1, wa->w, wa->step, (uint64_t) 0, windows,
+                        p->in_win, wa->padding, DSA_Access, DMO_Read, DMT_SPAD, d, 0);
+}